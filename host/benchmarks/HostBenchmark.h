@@ -0,0 +1,75 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Minimal support for the host benchmarks in this directory. Each benchmark is a separate executable that
+  * prints its results. They are not run by ctest, as their results depend on the machine they run on.
+  */
+
+#ifndef HOST_BENCHMARK_H
+#define HOST_BENCHMARK_H
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+  * Reads a monotonic clock of the host.
+  *
+  * @return The current time, in nanoseconds.
+  */
+static inline uint64_t host_benchmark_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/**
+  * Accumulates a series of timed samples.
+  */
+struct HostBenchmarkSamples
+{
+    uint64_t total;                     // The sum of all samples, in nanoseconds.
+    uint64_t worst;                     // The longest sample, in nanoseconds.
+    uint64_t count;                     // The number of samples.
+
+    HostBenchmarkSamples() : total(0), worst(0), count(0) {}
+
+    void add(uint64_t ns)
+    {
+        total += ns;
+        count++;
+
+        if (ns > worst)
+            worst = ns;
+    }
+
+    uint64_t mean()
+    {
+        return count ? total / count : 0;
+    }
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Measures the heap allocator under a random mix of allocations and frees, as the heap fragments.
+  *
+  * Up to 256 allocations are held at once. Each step picks one of them at random, and frees it if it is
+  * live, or otherwise allocates it: 80% of requests are of 1-120 bytes, and the rest of up to 600 bytes.
+  * 400000 steps are run by default, or the number given on the command line.
+  *
+  * Reported are the time for which interrupts are disabled by each critical section of device_malloc()
+  * and device_free(), the time taken by device_malloc(), and the fragmentation of the free memory,
+  * sampled every 1000 steps as 1 - (largest free region / free memory). The worst times include any
+  * preemption of the benchmark by the host, so the percentiles are the more reliable. Run with
+  * DEVICE_HEAP_CACHE and DEVICE_HEAP_SEGREGATED enabled and disabled to compare them.
+  */
+
+#include "CodalConfig.h"
+#include "CodalHeapAllocator.h"
+#include "ErrorNo.h"
+#include "codal_host_hal.h"
+#include "HostBenchmark.h"
+
+#define BENCHMARK_SLOTS         256
+#define BENCHMARK_MAX_WINDOWS   (2 * 1024 * 1024)
+
+static void *slots[BENCHMARK_SLOTS];
+
+static uint64_t *windows;
+static int windowCount = 0;
+static uint64_t windowStart = 0;
+static int measuring = 0;
+
+static void observe_irq(int disabled)
+{
+    if (!measuring)
+        return;
+
+    if (disabled)
+        windowStart = host_benchmark_ns();
+    else if (windowCount < BENCHMARK_MAX_WINDOWS)
+        windows[windowCount++] = host_benchmark_ns() - windowStart;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static uint64_t percentile(uint64_t *sorted, int count, int basisPoints)
+{
+    return count ? sorted[(int)((int64_t)(count - 1) * basisPoints / 10000)] : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int steps = argc > 1 ? atoi(argv[1]) : 400000;
+    uint32_t seed = 1;
+    HostBenchmarkSamples latency;
+    HostBenchmarkSamples windowSamples;
+    double fragmentation = 0;
+    double worstFragmentation = 0;
+    int fragmentationSamples = 0;
+    HeapStats stats;
+
+    windows = (uint64_t *)malloc(BENCHMARK_MAX_WINDOWS * sizeof(uint64_t));
+
+    host_set_irq_observer(observe_irq);
+
+    for (int i = 0; i < steps; i++)
+    {
+        // A fixed linear congruential generator, so that every build sees the same sequence.
+        seed = seed * 1103515245 + 12345;
+        int slot = (seed >> 8) % BENCHMARK_SLOTS;
+        seed = seed * 1103515245 + 12345;
+        int size = (seed >> 8) % 100 < 80 ? 1 + (seed >> 16) % 120 : 1 + (seed >> 16) % 600;
+
+        measuring = 1;
+
+        if (slots[slot])
+        {
+            device_free(slots[slot]);
+            slots[slot] = NULL;
+        }
+        else
+        {
+            uint64_t start = host_benchmark_ns();
+            slots[slot] = device_malloc(size);
+            latency.add(host_benchmark_ns() - start);
+        }
+
+        measuring = 0;
+
+        if (i % 1000 == 999 && device_heap_stats(0, &stats) == DEVICE_OK && stats.freeBytes > 0)
+        {
+            double f = 1.0 - (double)stats.largestFreeBytes / stats.freeBytes;
+
+            fragmentation += f;
+            fragmentationSamples++;
+
+            if (f > worstFragmentation)
+                worstFragmentation = f;
+        }
+    }
+
+    for (int i = 0; i < windowCount; i++)
+        windowSamples.add(windows[i]);
+
+    qsort(windows, windowCount, sizeof(uint64_t), compare_samples);
+    device_heap_stats(0, &stats);
+
+    printf("DEVICE_HEAP_CACHE %d, DEVICE_HEAP_SEGREGATED %d, %d steps\n", DEVICE_HEAP_CACHE, DEVICE_HEAP_SEGREGATED, steps);
+    printf("irq disabled: %d windows, mean %llu ns, p99 %llu ns, p99.9 %llu ns, p99.99 %llu ns, worst %llu ns\n", windowCount,
+        (unsigned long long)windowSamples.mean(), (unsigned long long)percentile(windows, windowCount, 9900),
+        (unsigned long long)percentile(windows, windowCount, 9990), (unsigned long long)percentile(windows, windowCount, 9999),
+        (unsigned long long)windowSamples.worst);
+    printf("device_malloc: %llu calls, mean %llu ns, worst %llu ns, %u failed\n", (unsigned long long)latency.count,
+        (unsigned long long)latency.mean(), (unsigned long long)latency.worst, (unsigned)stats.failed);
+    printf("fragmentation: mean %.3f, worst %.3f, %u free regions at end\n",
+        fragmentationSamples ? fragmentation / fragmentationSamples : 0.0, worstFragmentation, (unsigned)stats.freeBlocks);
+
+    free(windows);
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Measures the rate at which the MessageBus delivers events, as the number of registered listeners grows.
+  *
+  * For each number of event ids given on the command line (10, 50, 150 and 500 by default), two immediate
+  * listeners are registered on each id, alongside those of the scheduler. One million events are then raised on
+  * ids chosen at random, and the number of events delivered per second is reported. Run with
+  * MESSAGE_BUS_LISTENER_INDEX enabled and disabled to compare.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "HostBenchmark.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+#define BENCHMARK_EVENT_ID      7000
+#define BENCHMARK_EVENTS        1000000
+
+static volatile uint32_t delivered = 0;
+
+static void onEvent(Event)
+{
+    delivered++;
+}
+
+static void onEventAgain(Event)
+{
+    delivered++;
+}
+
+static void run(int ids)
+{
+    for (int i = 0; i < ids; i++)
+    {
+        bus->listen(BENCHMARK_EVENT_ID + i, DEVICE_EVT_ANY, onEvent, MESSAGE_BUS_LISTENER_IMMEDIATE);
+        bus->listen(BENCHMARK_EVENT_ID + i, DEVICE_EVT_ANY, onEventAgain, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    }
+
+    int listeners = 0;
+    while (bus->elementAt(listeners) != NULL)
+        listeners++;
+
+    srand(1);
+    delivered = 0;
+
+    uint64_t start = host_benchmark_ns();
+
+    for (int i = 0; i < BENCHMARK_EVENTS; i++)
+        Event(BENCHMARK_EVENT_ID + rand() % ids, 1);
+
+    uint64_t elapsed = host_benchmark_ns() - start;
+
+    printf("%4d ids, %5d listeners: %6.2fM events/s\n", ids, listeners, BENCHMARK_EVENTS * 1000.0 / elapsed);
+
+    if (delivered != 2 * BENCHMARK_EVENTS)
+        printf("  only %u of %u deliveries made\n", (unsigned)delivered, 2 * BENCHMARK_EVENTS);
+
+    for (int i = 0; i < ids; i++)
+    {
+        bus->ignore(BENCHMARK_EVENT_ID + i, DEVICE_EVT_ANY, onEvent);
+        bus->ignore(BENCHMARK_EVENT_ID + i, DEVICE_EVT_ANY, onEventAgain);
+    }
+
+    // Removed listeners are only freed once the scheduler idles.
+    fiber_sleep(1);
+}
+
+int main(int argc, char **argv)
+{
+    host_test_init();
+
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+            run(atoi(argv[i]));
+    }
+    else
+    {
+        run(10);
+        run(50);
+        run(150);
+        run(500);
+    }
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Measures the cost of the scheduler tick as the number of sleeping fibers grows.
+  *
+  * For each number of fibers given on the command line (10, 30, 100 and 300 by default), that many fibers are
+  * created, each of which repeatedly sleeps for a random period of 10-1000ms. Ten seconds of simulated time are
+  * then run. The time spent in each call to scheduler_tick() is reported, along with the host time taken to
+  * run the whole ten seconds, which also includes the cost of queueing each fiber as it goes to sleep.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "HostBenchmark.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+static HostBenchmarkSamples samples;
+
+static volatile bool running = false;
+static int sleeping = 0;
+
+static void measured_scheduler_tick(Event evt)
+{
+    uint64_t start = host_benchmark_ns();
+    scheduler_tick(evt);
+    samples.add(host_benchmark_ns() - start);
+}
+
+static void sleeper()
+{
+    sleeping++;
+
+    while (running)
+        fiber_sleep(10 + rand() % 990);
+
+    sleeping--;
+}
+
+static void run(int fibers)
+{
+    srand(1);
+    running = true;
+
+    for (int i = 0; i < fibers; i++)
+        create_fiber(sleeper);
+
+    // Let every sleeper go to sleep once, before we start measuring.
+    fiber_sleep(0);
+
+    samples = HostBenchmarkSamples();
+    uint64_t start = host_benchmark_ns();
+
+    fiber_sleep(10000);
+
+    uint64_t elapsed = host_benchmark_ns() - start;
+
+    printf("%4d fibers: %6llu ticks, mean %5llu ns, worst %6llu ns, %6llu us to run 10s\n", fibers,
+        (unsigned long long)samples.count, (unsigned long long)samples.mean(), (unsigned long long)samples.worst,
+        (unsigned long long)(elapsed / 1000));
+
+    // Wait for the sleepers to finish before the next run.
+    running = false;
+
+    while (sleeping)
+        fiber_sleep(100);
+}
+
+int main(int argc, char **argv)
+{
+    host_test_init();
+
+    // Time every scheduler tick, by standing in for the listener of the scheduler.
+    bus->ignore(DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_TICK, scheduler_tick);
+    bus->listen(DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_TICK, measured_scheduler_tick, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+            run(atoi(argv[i]));
+    }
+    else
+    {
+        run(10);
+        run(30);
+        run(100);
+        run(300);
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Measures the cost of the Timer interrupt handler as the number of pending timer events grows.
+  *
+  * For each number of events given on the command line (10, 50 and 200 by default), that many periodic
+  * events are set with periods of 1-10ms, and one second of simulated time is run. The time spent in each
+  * call to the interrupt handler is reported.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "HostBenchmark.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+// The interrupt handler of the Timer (see Timer.cpp).
+void timer_callback(uint16_t chan);
+
+#define BENCHMARK_EVENT_ID      7000
+
+static HostBenchmarkSamples samples;
+
+static void measured_timer_callback(uint16_t chan)
+{
+    uint64_t start = host_benchmark_ns();
+    timer_callback(chan);
+    samples.add(host_benchmark_ns() - start);
+}
+
+static void run(int events)
+{
+    srand(1);
+
+    // The event list grows in thread context, so let the scheduler run whenever it is full.
+    for (int i = 0; i < events; i++)
+        while (timer->eventEveryUs(1000 + rand() % 9000, BENCHMARK_EVENT_ID, i) != DEVICE_OK)
+            fiber_sleep(0);
+
+    samples = HostBenchmarkSamples();
+
+    for (int ms = 0; ms < 1000; ms++)
+        target_wait_us(1000);
+
+    printf("%4d events: %6llu interrupts, mean %5llu ns, worst %6llu ns\n", events,
+        (unsigned long long)samples.count, (unsigned long long)samples.mean(), (unsigned long long)samples.worst);
+
+    for (int i = 0; i < events; i++)
+        timer->cancel(BENCHMARK_EVENT_ID, i);
+}
+
+int main(int argc, char **argv)
+{
+    host_test_init();
+
+    lowLevelTimer->setIRQ(measured_timer_callback);
+
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+            run(atoi(argv[i]));
+    }
+    else
+    {
+        run(10);
+        run(50);
+        run(200);
+    }
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Measures the cost of waking many fibers at once.
+  *
+  * For each number of fibers given on the command line (10, 100, 500 and 2000 by default), that many fibers
+  * block on a FiberLock, and are woken by a single call to notifyAll(). The same fibers then block on an event,
+  * and are woken by raising it once. Each is repeated 20 times, and the mean time taken to block all the
+  * fibers, and to wake them all, is reported. Run with DEVICE_FIBER_QUEUE_TAIL enabled and disabled to compare.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "HostBenchmark.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+#define BENCHMARK_EVENT_ID      7000
+#define BENCHMARK_ROUNDS        20
+
+static FiberLock *lock;
+
+static int blocked = 0;
+
+static void waiter()
+{
+    for (int r = 0; r < BENCHMARK_ROUNDS; r++)
+    {
+        blocked++;
+        lock->wait();
+
+        blocked++;
+        fiber_wait_for_event(BENCHMARK_EVENT_ID, 1);
+    }
+}
+
+/**
+  * Blocks until every waiter has blocked, and reports how long that took.
+  */
+static uint64_t wait_for_waiters(int fibers)
+{
+    uint64_t start = host_benchmark_ns();
+
+    while (blocked < fibers)
+        schedule();
+
+    uint64_t elapsed = host_benchmark_ns() - start;
+    blocked = 0;
+
+    return elapsed;
+}
+
+static void run(int fibers)
+{
+    HostBenchmarkSamples lockBlock, lockWake, eventBlock, eventWake;
+
+    for (int i = 0; i < fibers; i++)
+        create_fiber(waiter);
+
+    // Hold the lock, so that the waiters block on it.
+    lock->wait();
+
+    for (int r = 0; r < BENCHMARK_ROUNDS; r++)
+    {
+        lockBlock.add(wait_for_waiters(fibers));
+
+        uint64_t start = host_benchmark_ns();
+        lock->notifyAll();
+        lockWake.add(host_benchmark_ns() - start);
+
+        lock->wait();
+
+        eventBlock.add(wait_for_waiters(fibers));
+
+        start = host_benchmark_ns();
+        Event(BENCHMARK_EVENT_ID, 1);
+        eventWake.add(host_benchmark_ns() - start);
+    }
+
+    lock->notifyAll();
+
+    // Let the waiters finish before the next run.
+    fiber_sleep(1);
+
+    printf("%5d fibers: FiberLock block %8llu ns, notifyAll %8llu ns; event block %8llu ns, wake %8llu ns\n", fibers,
+        (unsigned long long)lockBlock.mean(), (unsigned long long)lockWake.mean(),
+        (unsigned long long)eventBlock.mean(), (unsigned long long)eventWake.mean());
+}
+
+int main(int argc, char **argv)
+{
+    host_test_init();
+
+    lock = new FiberLock();
+
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+            run(atoi(argv[i]));
+    }
+    else
+    {
+        run(10);
+        run(100);
+        run(500);
+        run(2000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef HOST_LOW_LEVEL_TIMER_H
+#define HOST_LOW_LEVEL_TIMER_H
+
+#include "CodalConfig.h"
+#include "LowLevelTimer.h"
+
+#define HOST_TIMER_CHANNEL_COUNT            4
+
+namespace codal
+{
+
+/**
+  * A simulated 32 bit, 1MHz LowLevelTimer for the Linux host build.
+  *
+  * Simulated time only moves forward when it is explicitly advanced: when the scheduler idles
+  * (target_wait_for_event()), when code busy waits (target_wait(), target_wait_us() and
+  * system_timer_wait_cycles()), or through advance(). Runs are therefore fully deterministic, and
+  * never take longer than the code under test takes to execute.
+  *
+  * Compare matches are delivered to the timer_pointer handler as if it were an interrupt, unless
+  * interrupts are disabled through target_disable_irq(), in which case they are delivered as soon
+  * as interrupts are enabled again.
+  */
+class HostLowLevelTimer : public LowLevelTimer
+{
+    uint32_t counter;                               // The current value of the counter, in microseconds.
+    uint32_t compare[HOST_TIMER_CHANNEL_COUNT];     // The value of each compare channel.
+    uint16_t compareEnabled;                        // Bitmask of the compare channels that are in use.
+    uint16_t pending;                               // Bitmask of the compare channels that have matched, but not yet been delivered.
+    bool running;                                   // true if the counter is running.
+    bool irqEnabled;                                // true if compare matches are delivered to timer_pointer.
+
+    /**
+      * Determines the channels whose compare value is reached in the given number of ticks.
+      *
+      * @param ticks The number of ticks from now.
+      *
+      * @return A bitmask of the matching channels.
+      */
+    uint16_t matchesWithin(uint32_t ticks);
+
+    public:
+
+    /**
+      * The simulated timer most recently created, which drives the simulated time of the host HAL.
+      */
+    static HostLowLevelTimer *instance;
+
+    /**
+      * Constructor.
+      */
+    HostLowLevelTimer();
+
+    /**
+      * Starts the counter.
+      *
+      * @return DEVICE_OK
+      */
+    virtual int enable();
+
+    /**
+      * Enables the delivery of compare matches to timer_pointer.
+      *
+      * @return DEVICE_OK
+      */
+    virtual int enableIRQ();
+
+    /**
+      * Stops the counter.
+      *
+      * @return DEVICE_OK
+      */
+    virtual int disable();
+
+    /**
+      * Disables the delivery of compare matches to timer_pointer.
+      *
+      * @return DEVICE_OK
+      */
+    virtual int disableIRQ();
+
+    /**
+      * Sets the counter to zero.
+      *
+      * @return DEVICE_OK
+      */
+    virtual int reset();
+
+    /**
+      * Only TimerModeTimer is supported.
+      *
+      * @return DEVICE_OK, or DEVICE_NOT_SUPPORTED for any other mode.
+      */
+    virtual int setMode(TimerMode t);
+
+    /**
+      * Sets the compare value of the given channel, relative to zero.
+      *
+      * @param channel The compare channel to set.
+      *
+      * @param value The counter value at which the channel matches.
+      *
+      * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if the channel does not exist.
+      */
+    virtual int setCompare(uint8_t channel, uint32_t value);
+
+    /**
+      * Moves the compare value of the given channel forward.
+      *
+      * @param channel The compare channel to offset.
+      *
+      * @param value The number of ticks to add to the current compare value.
+      *
+      * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if the channel does not exist.
+      */
+    virtual int offsetCompare(uint8_t channel, uint32_t value);
+
+    /**
+      * Stops the given channel from matching.
+      *
+      * @param channel The compare channel to clear.
+      *
+      * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if the channel does not exist.
+      */
+    virtual int clearCompare(uint8_t channel);
+
+    /**
+      * Reads the counter.
+      *
+      * @return The current value of the counter.
+      */
+    virtual uint32_t captureCounter();
+
+    /**
+      * The simulated counter always runs at 1MHz.
+      *
+      * @return DEVICE_OK if speedKHz is 1000, DEVICE_NOT_SUPPORTED otherwise.
+      */
+    virtual int setClockSpeed(uint32_t speedKHz);
+
+    /**
+      * The simulated counter is always 32 bits wide.
+      *
+      * @return DEVICE_OK if t is BitMode32, DEVICE_NOT_SUPPORTED otherwise.
+      */
+    virtual int setBitMode(TimerBitMode t);
+
+    /**
+      * Advances simulated time, delivering any compare matches along the way in the order they occur.
+      *
+      * @param us The number of microseconds to advance by.
+      *
+      * @return DEVICE_OK
+      */
+    int advance(uint32_t us);
+
+    /**
+      * Advances simulated time up to the next compare match, and delivers it.
+      *
+      * @return DEVICE_OK, or DEVICE_INVALID_STATE if the counter is stopped or no compare channel is in use.
+      */
+    int advanceToNextMatch();
+
+    /**
+      * Delivers any compare matches that occurred whilst interrupts were disabled.
+      * Called by the host HAL when interrupts are enabled.
+      */
+    void deliverPending();
+};
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CODAL_HOST_HAL_H
+#define CODAL_HOST_HAL_H
+
+#include "codal_target_hal.h"
+
+/**
+  * Simulated CPU clock of the host build, used to convert busy wait cycles into simulated time.
+  */
+#ifndef HOST_SIMULATED_CPU_MHZ
+#define HOST_SIMULATED_CPU_MHZ              64
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+      * Determines if interrupts are currently disabled through target_disable_irq().
+      *
+      * @return The number of outstanding calls to target_disable_irq(), or 0 if interrupts are enabled.
+      */
+    int host_irq_disabled();
+
+    /**
+      * Registers a function to be called whenever interrupts are disabled or enabled again through
+      * target_disable_irq() and target_enable_irq(). Nested calls are not reported. This is used by the
+      * host benchmarks to measure the time for which interrupts are disabled.
+      *
+      * @param observer The function to call, with 1 as interrupts are disabled and 0 as they are enabled,
+      *                 or NULL to remove any observer.
+      */
+    void host_set_irq_observer(void (*observer)(int disabled));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Platform definitions for the Linux host build of codal-core.
+  * See codal_host_hal.cpp.
+  */
+
+#ifndef PLATFORM_INCLUDES_H
+#define PLATFORM_INCLUDES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <math.h>
+
+#define PROCESSOR_WORD_TYPE                 uintptr_t
+
+/**
+  * The size of the static region managed by the heap allocator (see codal_host_hal.cpp).
+  * The C library heap remains in use by the host, so it is not replaced (see DEVICE_HEAP_REPLACE_LIBC).
+  */
+#ifndef HOST_HEAP_SIZE
+#define HOST_HEAP_SIZE                      (64 * 1024)
+#endif
+
+// The heap allocator places the end of its default heap at the bottom of the stack. There is no such
+// stack on the host, so end the heap at the end of the static region instead.
+#define DEVICE_STACK_BASE                   (codal_heap_start + HOST_HEAP_SIZE)
+#define DEVICE_STACK_SIZE                   0
+
+#endif
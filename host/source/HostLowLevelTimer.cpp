@@ -0,0 +1,214 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "HostLowLevelTimer.h"
+#include "codal_host_hal.h"
+#include "ErrorNo.h"
+
+using namespace codal;
+
+HostLowLevelTimer *HostLowLevelTimer::instance = NULL;
+
+/**
+  * Constructor.
+  */
+HostLowLevelTimer::HostLowLevelTimer() : LowLevelTimer(HOST_TIMER_CHANNEL_COUNT)
+{
+    bitMode = BitMode32;
+    counter = 0;
+    compareEnabled = 0;
+    pending = 0;
+    running = false;
+    irqEnabled = true;
+
+    for (int i = 0; i < HOST_TIMER_CHANNEL_COUNT; i++)
+        compare[i] = 0;
+
+    // Most recent timer wins, in line with system_timer.
+    instance = this;
+}
+
+uint16_t HostLowLevelTimer::matchesWithin(uint32_t ticks)
+{
+    uint16_t matches = 0;
+
+    for (int i = 0; i < HOST_TIMER_CHANNEL_COUNT; i++)
+    {
+        uint32_t distance = compare[i] - counter;
+
+        if (compareEnabled & (1 << i) && distance != 0 && distance <= ticks)
+            matches |= (1 << i);
+    }
+
+    return matches;
+}
+
+int HostLowLevelTimer::enable()
+{
+    running = true;
+    return DEVICE_OK;
+}
+
+int HostLowLevelTimer::enableIRQ()
+{
+    irqEnabled = true;
+    deliverPending();
+    return DEVICE_OK;
+}
+
+int HostLowLevelTimer::disable()
+{
+    running = false;
+    return DEVICE_OK;
+}
+
+int HostLowLevelTimer::disableIRQ()
+{
+    irqEnabled = false;
+    return DEVICE_OK;
+}
+
+int HostLowLevelTimer::reset()
+{
+    counter = 0;
+    return DEVICE_OK;
+}
+
+int HostLowLevelTimer::setMode(TimerMode t)
+{
+    return t == TimerModeTimer ? DEVICE_OK : DEVICE_NOT_SUPPORTED;
+}
+
+int HostLowLevelTimer::setCompare(uint8_t channel, uint32_t value)
+{
+    if (channel >= HOST_TIMER_CHANNEL_COUNT)
+        return DEVICE_INVALID_PARAMETER;
+
+    compare[channel] = value;
+    compareEnabled |= (1 << channel);
+    pending &= ~(1 << channel);
+
+    return DEVICE_OK;
+}
+
+int HostLowLevelTimer::offsetCompare(uint8_t channel, uint32_t value)
+{
+    if (channel >= HOST_TIMER_CHANNEL_COUNT)
+        return DEVICE_INVALID_PARAMETER;
+
+    return setCompare(channel, compare[channel] + value);
+}
+
+int HostLowLevelTimer::clearCompare(uint8_t channel)
+{
+    if (channel >= HOST_TIMER_CHANNEL_COUNT)
+        return DEVICE_INVALID_PARAMETER;
+
+    compareEnabled &= ~(1 << channel);
+    pending &= ~(1 << channel);
+
+    return DEVICE_OK;
+}
+
+uint32_t HostLowLevelTimer::captureCounter()
+{
+    return counter;
+}
+
+int HostLowLevelTimer::setClockSpeed(uint32_t speedKHz)
+{
+    return speedKHz == 1000 ? DEVICE_OK : DEVICE_NOT_SUPPORTED;
+}
+
+int HostLowLevelTimer::setBitMode(TimerBitMode t)
+{
+    return t == BitMode32 ? DEVICE_OK : DEVICE_NOT_SUPPORTED;
+}
+
+int HostLowLevelTimer::advance(uint32_t us)
+{
+    if (!running)
+        return DEVICE_OK;
+
+    while (us)
+    {
+        // Move up to the nearest compare match within the period, if any, so that matches are delivered in order.
+        uint32_t step = us;
+
+        for (int i = 0; i < HOST_TIMER_CHANNEL_COUNT; i++)
+        {
+            uint32_t distance = compare[i] - counter;
+
+            if (compareEnabled & (1 << i) && distance != 0 && distance < step)
+                step = distance;
+        }
+
+        pending |= matchesWithin(step);
+        counter += step;
+        us -= step;
+
+        deliverPending();
+    }
+
+    return DEVICE_OK;
+}
+
+int HostLowLevelTimer::advanceToNextMatch()
+{
+    uint32_t step = 0;
+
+    for (int i = 0; i < HOST_TIMER_CHANNEL_COUNT; i++)
+    {
+        uint32_t distance = compare[i] - counter;
+
+        if (compareEnabled & (1 << i) && distance != 0 && (step == 0 || distance < step))
+            step = distance;
+    }
+
+    if (!running || step == 0)
+        return DEVICE_INVALID_STATE;
+
+    return advance(step);
+}
+
+void HostLowLevelTimer::deliverPending()
+{
+    static bool delivering = false;
+
+    // Compare matches are delivered one batch at a time, as an interrupt handler would be.
+    if (delivering || !irqEnabled || timer_pointer == NULL || host_irq_disabled())
+        return;
+
+    delivering = true;
+
+    while (pending)
+    {
+        uint16_t channels = pending;
+        pending = 0;
+
+        timer_pointer(channels);
+    }
+
+    delivering = false;
+}
@@ -0,0 +1,202 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Implementation of the target HAL for the Linux host build of codal-core.
+  *
+  * Fibers are context switched as they are on device: all fibers execute on the process stack, which
+  * is copied to and from the stack buffer of each fiber as it is scheduled out and in (see
+  * HostContextSwitch.S). Time is simulated by HostLowLevelTimer, and interrupts are emulated by
+  * delivering its compare matches whenever they are not disabled through target_disable_irq().
+  *
+  * As on device, objects that outlive a context switch (e.g. the Timer and MessageBus) must not be
+  * allocated on the stack of main(), as that stack is shared by all fibers.
+  *
+  * The heap allocator runs over a static region of HOST_HEAP_SIZE bytes, and is used through
+  * device_malloc() and device_free(). malloc() and operator new remain those of the host C library.
+  */
+
+#include "codal_host_hal.h"
+#include "HostLowLevelTimer.h"
+#include "Timer.h"
+#include "CodalDmesg.h"
+#include "CodalHeapAllocator.h"
+
+using namespace codal;
+
+/**
+  * The thread control block of a fiber. The layout is shared with HostContextSwitch.S.
+  */
+struct HOST_TCB
+{
+    PROCESSOR_WORD_TYPE rbx, rbp, r12, r13, r14, r15;   // Callee saved registers.
+    PROCESSOR_WORD_TYPE sp;                             // Stack pointer.
+    PROCESSOR_WORD_TYPE pc;                             // Address execution resumes from.
+    PROCESSOR_WORD_TYPE args[3];                        // Arguments passed to pc when a fiber is first scheduled in.
+};
+
+// The initial stack pointer of the process, provided by glibc. All frames of the process lie below it.
+extern "C" void *__libc_stack_end;
+
+// The base of the stack that all fibers execute on. Used by HostContextSwitch.S.
+extern "C" PROCESSOR_WORD_TYPE host_stack_base;
+PROCESSOR_WORD_TYPE host_stack_base = 0;
+
+// The region managed by the heap allocator, of HOST_HEAP_SIZE bytes.
+static PROCESSOR_WORD_TYPE host_heap[HOST_HEAP_SIZE / sizeof(PROCESSOR_WORD_TYPE)];
+PROCESSOR_WORD_TYPE codal_heap_start = (PROCESSOR_WORD_TYPE)host_heap;
+
+static int irqDisabled = 0;
+static void (*irqObserver)(int) = NULL;
+
+void target_init()
+{
+    fiber_initial_stack_base();
+}
+
+void target_enable_irq()
+{
+    if (irqDisabled > 0)
+    {
+        irqDisabled--;
+
+        if (irqDisabled == 0 && irqObserver)
+            irqObserver(0);
+    }
+
+    if (irqDisabled == 0 && HostLowLevelTimer::instance)
+        HostLowLevelTimer::instance->deliverPending();
+}
+
+void target_disable_irq()
+{
+    if (irqDisabled++ == 0 && irqObserver)
+        irqObserver(1);
+}
+
+int host_irq_disabled()
+{
+    return irqDisabled;
+}
+
+void host_set_irq_observer(void (*observer)(int disabled))
+{
+    irqObserver = observer;
+}
+
+void target_reset()
+{
+    // There is nothing to restart on the host, so a reset terminates the process.
+    exit(EXIT_SUCCESS);
+}
+
+void target_wait(uint32_t milliseconds)
+{
+    if (HostLowLevelTimer::instance)
+        HostLowLevelTimer::instance->advance(milliseconds * 1000);
+}
+
+void target_wait_us(uint32_t us)
+{
+    if (HostLowLevelTimer::instance)
+        HostLowLevelTimer::instance->advance(us);
+}
+
+uint64_t target_get_serial()
+{
+    return 0x484f5354;
+}
+
+void target_wait_for_event()
+{
+    // Nothing can happen on the host until the next compare match, so skip straight to it.
+    if (HostLowLevelTimer::instance)
+        HostLowLevelTimer::instance->advanceToNextMatch();
+}
+
+void target_panic(int statusCode)
+{
+    target_disable_irq();
+
+    DMESG("*** CODAL PANIC : [%d]", statusCode);
+    fprintf(stderr, "*** CODAL PANIC : [%d]\n", statusCode);
+    abort();
+}
+
+/**
+  * Simulates a busy wait, by advancing simulated time by the time the given number of cycles
+  * would take at HOST_SIMULATED_CPU_MHZ.
+  */
+void codal::system_timer_wait_cycles(uint32_t cycles)
+{
+    if (HostLowLevelTimer::instance)
+        HostLowLevelTimer::instance->advance(cycles / HOST_SIMULATED_CPU_MHZ);
+}
+
+PROCESSOR_WORD_TYPE fiber_initial_stack_base()
+{
+    if (host_stack_base == 0)
+        host_stack_base = (PROCESSOR_WORD_TYPE)__libc_stack_end & ~(PROCESSOR_WORD_TYPE)0x0f;
+
+    return host_stack_base;
+}
+
+void *tcb_allocate()
+{
+    return calloc(1, sizeof(HOST_TCB));
+}
+
+void tcb_configure_lr(void *tcb, PROCESSOR_WORD_TYPE function)
+{
+    ((HOST_TCB *)tcb)->pc = function;
+}
+
+void tcb_configure_sp(void *tcb, PROCESSOR_WORD_TYPE sp)
+{
+    // Align as the ABI expects on entry to a function, i.e. just after a return address has been pushed.
+    ((HOST_TCB *)tcb)->sp = (sp & ~(PROCESSOR_WORD_TYPE)0x0f) - sizeof(PROCESSOR_WORD_TYPE);
+}
+
+void tcb_configure_stack_base(void *, PROCESSOR_WORD_TYPE)
+{
+    // The full stack of each fiber is always saved, including that of fibers forked by invoke().
+    // This costs some RAM, but is insensitive to how the compiler lays out the frame of invoke().
+}
+
+PROCESSOR_WORD_TYPE tcb_get_stack_base(void *)
+{
+    return fiber_initial_stack_base();
+}
+
+PROCESSOR_WORD_TYPE tcb_get_sp(void *tcb)
+{
+    return ((HOST_TCB *)tcb)->sp;
+}
+
+void tcb_configure_args(void *tcb, PROCESSOR_WORD_TYPE ep, PROCESSOR_WORD_TYPE cp, PROCESSOR_WORD_TYPE pm)
+{
+    ((HOST_TCB *)tcb)->args[0] = ep;
+    ((HOST_TCB *)tcb)->args[1] = cp;
+    ((HOST_TCB *)tcb)->args[2] = pm;
+}
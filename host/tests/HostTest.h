@@ -0,0 +1,84 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Minimal support for the host tests in this directory. Each test is a separate executable, run by ctest,
+  * that returns zero if every check passed. The host benchmarks share host_test_init().
+  */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+
+static int host_test_failures = 0;
+
+// The simulated system, created by host_test_init().
+static codal::HostLowLevelTimer *lowLevelTimer;
+static codal::Timer *timer;
+static codal::MessageBus *bus;
+
+/**
+  * Brings up the target, a Timer over a simulated LowLevelTimer, a MessageBus, and the scheduler.
+  *
+  * As on device, these outlive any context switch, so are allocated on the heap rather than the stack of main().
+  */
+static inline void host_test_init()
+{
+    target_init();
+
+    lowLevelTimer = new codal::HostLowLevelTimer();
+    timer = new codal::Timer(*lowLevelTimer);
+    bus = new codal::MessageBus();
+    codal::scheduler_init(*bus);
+}
+
+/**
+  * Records a failure, reporting where it occurred, if the given condition does not hold.
+  */
+#define HOST_CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        host_test_failures++; \
+    } \
+} while (0)
+
+/**
+  * Reports the outcome of the test.
+  *
+  * @return The exit code of the test: 0 if every check passed, 1 otherwise.
+  */
+static inline int host_test_result()
+{
+    if (host_test_failures)
+        fprintf(stderr, "%d check(s) failed\n", host_test_failures);
+
+    return host_test_failures ? 1 : 0;
+}
+
+#endif
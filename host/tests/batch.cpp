@@ -0,0 +1,178 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of events raised in batches (see MessageBus::sendBatch()).
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "ErrorNo.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+#define TEST_EVENT_ID           9400
+#define TEST_URGENT_ID          9401
+#define TEST_IRQ_ID             9402
+
+static int order[32];
+static int orderCount = 0;
+static int batchCalls = 0;
+static int batchEvents = 0;
+static int urgentCount = 0;
+
+static void onEvent(Event e)
+{
+    order[orderCount++] = e.value;
+}
+
+static void onBatch(const Event *events, int count)
+{
+    batchCalls++;
+    batchEvents += count;
+}
+
+static void onUrgent(Event e)
+{
+    urgentCount++;
+}
+
+static void onTimer(Event)
+{
+    Event events[3];
+
+    for (int i = 0; i < 3; i++)
+        events[i] = Event(TEST_EVENT_ID, 20 + i, CREATE_ONLY);
+
+    bus->sendBatch(events, 3);
+}
+
+static void reset()
+{
+    orderCount = 0;
+    batchCalls = 0;
+    batchEvents = 0;
+}
+
+static void test_order()
+{
+    Event events[3];
+
+    for (int i = 0; i < 3; i++)
+        events[i] = Event(TEST_EVENT_ID, 2 + i, CREATE_ONLY);
+
+    // A batch is delivered in its place among events raised through send().
+    Event(TEST_EVENT_ID, 1);
+    HOST_CHECK(bus->sendBatch(events, 3) == DEVICE_OK);
+    Event(TEST_EVENT_ID, 5);
+
+    fiber_sleep(1);
+
+    HOST_CHECK(orderCount == 5);
+
+    for (int i = 0; i < orderCount; i++)
+        HOST_CHECK(order[i] == i + 1);
+
+    // A batch listener receives all of its events in one call.
+    HOST_CHECK(batchCalls == 3);
+    HOST_CHECK(batchEvents == 5);
+}
+
+static void test_urgent()
+{
+    Event events[4];
+
+    reset();
+
+    // Events taken by urgent listeners alone are not queued, and the rest keep their order.
+    events[0] = Event(TEST_EVENT_ID, 1, CREATE_ONLY);
+    events[1] = Event(TEST_URGENT_ID, 1, CREATE_ONLY);
+    events[2] = Event(TEST_EVENT_ID, 2, CREATE_ONLY);
+    events[3] = Event(TEST_URGENT_ID, 2, CREATE_ONLY);
+
+    HOST_CHECK(bus->sendBatch(events, 4) == DEVICE_OK);
+    HOST_CHECK(urgentCount == 2);
+
+    fiber_sleep(1);
+
+    HOST_CHECK(orderCount == 2);
+    HOST_CHECK(order[0] == 1 && order[1] == 2);
+    HOST_CHECK(batchCalls == 1 && batchEvents == 2);
+}
+
+static void test_interrupt()
+{
+    reset();
+
+    // sendBatch() allocates nothing, so may be called from a timer interrupt.
+    system_timer_event_after(5, TEST_IRQ_ID, 1);
+    fiber_sleep(10);
+
+    HOST_CHECK(orderCount == 3);
+    HOST_CHECK(order[0] == 20 && order[1] == 21 && order[2] == 22);
+}
+
+static void test_full()
+{
+    static Event events[MESSAGE_BUS_EVENT_QUEUE_SIZE + 1];
+    uint32_t dropped = bus->getDroppedEventCount();
+
+    reset();
+
+    for (int i = 0; i <= MESSAGE_BUS_EVENT_QUEUE_SIZE; i++)
+        events[i] = Event(TEST_EVENT_ID, 1, CREATE_ONLY);
+
+    // A batch larger than the queue is dropped as a whole.
+    HOST_CHECK(bus->sendBatch(events, MESSAGE_BUS_EVENT_QUEUE_SIZE + 1) == DEVICE_NO_RESOURCES);
+    HOST_CHECK(bus->getDroppedEventCount() == dropped + MESSAGE_BUS_EVENT_QUEUE_SIZE + 1);
+
+    fiber_sleep(1);
+    HOST_CHECK(orderCount == 0);
+
+    // One that fits is delivered whole.
+    HOST_CHECK(bus->sendBatch(events, MESSAGE_BUS_EVENT_QUEUE_SIZE) == DEVICE_OK);
+    fiber_sleep(1);
+    HOST_CHECK(orderCount == MESSAGE_BUS_EVENT_QUEUE_SIZE);
+}
+
+int main()
+{
+    host_test_init();
+
+    bus->listen(TEST_EVENT_ID, DEVICE_EVT_ANY, onEvent);
+    bus->listen(TEST_EVENT_ID, DEVICE_EVT_ANY, onBatch);
+    bus->listen(TEST_URGENT_ID, DEVICE_EVT_ANY, onUrgent, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    bus->listen(TEST_IRQ_ID, 1, onTimer, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+    test_order();
+    test_urgent();
+    test_interrupt();
+    test_full();
+
+    return host_test_result();
+}
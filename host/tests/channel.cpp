@@ -0,0 +1,114 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of typed event channels (see CodalChannel.h).
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "CodalChannel.h"
+#include "CoordinateSystem.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+// As on device, the stack is shared by all fibers, so anything handed to a listener must not live on it.
+static int received = 0;
+static int sum = 0;
+static int calls = 0;
+
+static void onSample(const Sample3D &s, void *context)
+{
+    received++;
+    sum += s.x;
+    (*(int *)context)++;
+}
+
+static void test_delivery()
+{
+    Channel<Sample3D> *channel = new Channel<Sample3D>(3000);
+    Sample3D s;
+
+    HOST_CHECK(channel->subscribe(onSample, &calls) == DEVICE_OK);
+
+    // Only as many payloads as there are slots can be waiting at once. The rest are dropped.
+    for (int i = 1; i <= 6; i++)
+    {
+        s.x = i;
+        channel->publish(s);
+    }
+
+    fiber_sleep(5);
+
+    HOST_CHECK(received == 4);
+    HOST_CHECK(calls == 4);
+    HOST_CHECK(sum == 1 + 2 + 3 + 4);
+    HOST_CHECK(channel->getDroppedCount() == 2);
+
+    delete channel;
+}
+
+static void test_coalescing_entries()
+{
+    Channel<Sample3D> *channels[MESSAGE_BUS_COALESCE_MAX + 1];
+
+    calls = 0;
+
+    for (int i = 0; i <= MESSAGE_BUS_COALESCE_MAX; i++)
+        channels[i] = new Channel<Sample3D>(3100 + i);
+
+    // Each channel with subscribers holds one of the coalescing entries of the bus...
+    for (int i = 0; i < MESSAGE_BUS_COALESCE_MAX; i++)
+        HOST_CHECK(channels[i]->subscribe(onSample, &calls) == DEVICE_OK);
+
+    // ... so once they are exhausted, subscription fails rather than silently losing coalescing.
+    HOST_CHECK(channels[MESSAGE_BUS_COALESCE_MAX]->subscribe(onSample, &calls) == DEVICE_NO_RESOURCES);
+
+    // Destroying a channel releases its entry.
+    delete channels[0];
+    HOST_CHECK(channels[MESSAGE_BUS_COALESCE_MAX]->subscribe(onSample, &calls) == DEVICE_OK);
+
+    Sample3D s;
+    s.x = 1;
+    HOST_CHECK(channels[MESSAGE_BUS_COALESCE_MAX]->publish(s) == DEVICE_OK);
+    fiber_sleep(5);
+    HOST_CHECK(calls == 1);
+
+    for (int i = 1; i <= MESSAGE_BUS_COALESCE_MAX; i++)
+        delete channels[i];
+}
+
+int main()
+{
+    host_test_init();
+
+    test_delivery();
+    test_coalescing_entries();
+
+    return host_test_result();
+}
@@ -0,0 +1,123 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of the deferred call queue (see fiber_defer()).
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+static int order[2 * SCHEDULER_DEFERRED_QUEUE_SIZE];
+static int calls = 0;
+static int blocked = 0;
+
+static void call(void *p)
+{
+    order[calls++] = (int)(intptr_t)p;
+}
+
+static void slow(void *)
+{
+    fiber_sleep(5);
+    blocked++;
+}
+
+static void test_order()
+{
+    int results[SCHEDULER_DEFERRED_QUEUE_SIZE + 1];
+
+    calls = 0;
+
+    HOST_CHECK(fiber_defer(NULL, NULL) == DEVICE_INVALID_PARAMETER);
+
+    // Calls are made in order, and one that blocks does not hold up those after it.
+    HOST_CHECK(fiber_defer(slow, NULL) == DEVICE_OK);
+
+    for (int i = 0; i < SCHEDULER_DEFERRED_QUEUE_SIZE; i++)
+        results[i] = fiber_defer(call, (void *)(intptr_t)i);
+
+    for (int i = 0; i < SCHEDULER_DEFERRED_QUEUE_SIZE - 1; i++)
+        HOST_CHECK(results[i] == DEVICE_OK);
+
+    HOST_CHECK(results[SCHEDULER_DEFERRED_QUEUE_SIZE - 1] == DEVICE_NO_RESOURCES);
+
+    fiber_sleep(20);
+
+    HOST_CHECK(blocked == 1);
+    HOST_CHECK(calls == SCHEDULER_DEFERRED_QUEUE_SIZE - 1);
+
+    for (int i = 0; i < calls; i++)
+        HOST_CHECK(order[i] == i);
+}
+
+static void test_reserved()
+{
+    calls = 0;
+
+    HOST_CHECK(fiber_defer_reserve() == DEVICE_OK);
+
+    // Once reserved, a slot is no longer available to other callers...
+    for (int i = 0; i < SCHEDULER_DEFERRED_QUEUE_SIZE - 1; i++)
+        HOST_CHECK(fiber_defer(call, (void *)(intptr_t)i) == DEVICE_OK);
+
+    HOST_CHECK(fiber_defer(call, NULL) == DEVICE_NO_RESOURCES);
+
+    // ... nor can the last slot be reserved, as it is in use.
+    HOST_CHECK(fiber_defer_reserve() == DEVICE_NO_RESOURCES);
+
+    // ... but the holder of the reservation can always defer one call of its own, even though the queue is full.
+    HOST_CHECK(fiber_defer(call, (void *)(intptr_t)(SCHEDULER_DEFERRED_QUEUE_SIZE - 1), true) == DEVICE_OK);
+    HOST_CHECK(fiber_defer(call, NULL, true) == DEVICE_NO_RESOURCES);
+
+    fiber_sleep(20);
+
+    HOST_CHECK(calls == SCHEDULER_DEFERRED_QUEUE_SIZE);
+
+    for (int i = 0; i < calls; i++)
+        HOST_CHECK(order[i] == i);
+
+    // The reserved slot is available again once its call has been made.
+    HOST_CHECK(fiber_defer(call, (void *)(intptr_t)calls, true) == DEVICE_OK);
+
+    fiber_sleep(20);
+
+    HOST_CHECK(calls == SCHEDULER_DEFERRED_QUEUE_SIZE + 1);
+}
+
+int main()
+{
+    host_test_init();
+
+    test_order();
+    test_reserved();
+
+    return host_test_result();
+}
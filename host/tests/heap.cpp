@@ -0,0 +1,238 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of the heap allocator, running over the static heap of the host build.
+  * These pass whether or not DEVICE_HEAP_CACHE and DEVICE_HEAP_SEGREGATED are enabled.
+  */
+
+#include "CodalConfig.h"
+#include "CodalHeapAllocator.h"
+#include "CodalCompat.h"
+#include "ErrorNo.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+static void test_realloc()
+{
+    uint32_t inPlace, moved, inPlaceBefore, movedBefore;
+
+    device_realloc_stats(&inPlaceBefore, &movedBefore);
+
+    // With no previous memory, device_realloc() behaves as device_malloc().
+    char *a = (char *)device_realloc(NULL, 200);
+    HOST_CHECK(a != NULL);
+    memset(a, 'a', 200);
+
+    char *b = (char *)device_malloc(200);
+    device_free(b);
+
+    // Growing into the free block that follows resizes in place.
+    char *a2 = (char *)device_realloc(a, 400);
+    HOST_CHECK(a2 == a);
+    HOST_CHECK(a2[199] == 'a');
+
+    char *c = (char *)device_malloc(16);
+
+    // Shrinking always resizes in place.
+    char *a3 = (char *)device_realloc(a2, 40);
+    HOST_CHECK(a3 == a);
+
+    // Growing past the block that now follows moves the memory, preserving its contents.
+    char *a4 = (char *)device_realloc(a3, 1000);
+    HOST_CHECK(a4 != a);
+    HOST_CHECK(a4[39] == 'a');
+
+    device_realloc_stats(&inPlace, &moved);
+    HOST_CHECK(inPlace - inPlaceBefore == 2);
+    HOST_CHECK(moved - movedBefore == 1);
+
+    device_free(a4);
+    device_free(c);
+}
+
+static void test_churn()
+{
+    const int slots = 64;
+    char *p[slots];
+    size_t sz[slots];
+    HeapStats stats;
+
+    memset(p, 0, sizeof(p));
+    memset(sz, 0, sizeof(sz));
+    srand(3);
+
+    // Reallocate and free blocks at random, checking that no block is overwritten by another.
+    for (int k = 0; k < 100000; k++)
+    {
+        int i = rand() % slots;
+        size_t n = rand() % 300 + 1;
+
+        if (p[i] && rand() % 3 == 0)
+        {
+            device_free(p[i]);
+            p[i] = NULL;
+            sz[i] = 0;
+            continue;
+        }
+
+        char *q = (char *)device_realloc(p[i], n);
+        HOST_CHECK(q != NULL);
+
+        for (size_t j = 0; j < min(n, sz[i]); j++)
+            if (q[j] != (char)(i + j))
+            {
+                HOST_CHECK(q[j] == (char)(i + j));
+                break;
+            }
+
+        for (size_t j = 0; j < n; j++)
+            q[j] = (char)(i + j);
+
+        p[i] = q;
+        sz[i] = n;
+    }
+
+    for (int i = 0; i < slots; i++)
+        device_free(p[i]);
+
+    HOST_CHECK(device_heap_stats(0, &stats) == DEVICE_OK);
+    HOST_CHECK(stats.usedBytes == 0);
+    HOST_CHECK(stats.usedBlocks == 0);
+    HOST_CHECK(stats.peakBytes <= stats.totalBytes);
+    HOST_CHECK(stats.failed == 0);
+
+    // Once everything is freed, the heap can be allocated as a single block again.
+    void *all = device_malloc(HOST_HEAP_SIZE - 2 * DEVICE_HEAP_BLOCK_SIZE);
+    HOST_CHECK(all != NULL);
+    device_free(all);
+}
+
+static void test_stats()
+{
+    HeapStats stats;
+
+    HOST_CHECK(device_heap_stats(0, NULL) == DEVICE_INVALID_PARAMETER);
+    HOST_CHECK(device_heap_stats(DEVICE_MAXIMUM_HEAPS, &stats) == DEVICE_INVALID_PARAMETER);
+
+    void *a = device_malloc(10);
+    void *b = device_malloc(100);
+
+    HOST_CHECK(device_heap_stats(0, &stats) == DEVICE_OK);
+    HOST_CHECK(stats.totalBytes == HOST_HEAP_SIZE);
+    HOST_CHECK(stats.usedBlocks == 2);
+    HOST_CHECK(stats.usedBytes >= 110 + 2 * DEVICE_HEAP_BLOCK_SIZE);
+    HOST_CHECK(stats.freeBytes == stats.totalBytes - stats.usedBytes);
+    HOST_CHECK(stats.largestFreeBytes <= stats.freeBytes);
+
+    device_free(a);
+    device_free(b);
+}
+
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+static PROCESSOR_WORD_TYPE block_header(void *mem)
+{
+    return ((PROCESSOR_WORD_TYPE *)mem)[-1];
+}
+
+static void test_coalesce()
+{
+    // Larger than any size class cache, so that every free goes straight back to the heap.
+    const int size = 200;
+
+    char *a = (char *)device_malloc(size);
+    char *b = (char *)device_malloc(size);
+    char *c = (char *)device_malloc(size);
+    char *d = (char *)device_malloc(size);
+
+    // Freeing a block merges it with a free block after it...
+    device_free(b);
+    device_free(a);
+    HOST_CHECK(block_header(a) & DEVICE_HEAP_BLOCK_FREE);
+    HOST_CHECK((block_header(a) & ~DEVICE_HEAP_BLOCK_FLAGS) == (PROCESSOR_WORD_TYPE)((PROCESSOR_WORD_TYPE *)c - (PROCESSOR_WORD_TYPE *)a));
+
+    // ... and with a free block before it.
+    device_free(c);
+    HOST_CHECK((block_header(a) & ~DEVICE_HEAP_BLOCK_FLAGS) == (PROCESSOR_WORD_TYPE)((PROCESSOR_WORD_TYPE *)d - (PROCESSOR_WORD_TYPE *)a));
+    HOST_CHECK(block_header(d) & DEVICE_HEAP_BLOCK_PREV_FREE);
+
+    // The merged block is reused for an allocation that none of its parts could hold.
+    char *e = (char *)device_malloc(3 * size);
+    HOST_CHECK(e == a);
+    HOST_CHECK(!(block_header(d) & DEVICE_HEAP_BLOCK_PREV_FREE));
+
+    device_free(e);
+    device_free(d);
+}
+
+static void test_best_fit()
+{
+    // The smallest free block held in the tree, rather than in a size class list.
+    const size_t large = (size_t)4 << DEVICE_HEAP_SEGREGATED_CLASSES;
+    const size_t extra[] = { 100, 10, 300, 50, 200 };
+    const int count = sizeof(extra) / sizeof(extra[0]);
+    void *blocks[count];
+    void *guards[count];
+
+    // Free large blocks of different sizes, kept apart by used blocks.
+    for (int i = 0; i < count; i++)
+    {
+        blocks[i] = device_malloc((large + extra[i]) * DEVICE_HEAP_BLOCK_SIZE);
+        guards[i] = device_malloc(DEVICE_HEAP_BLOCK_SIZE);
+    }
+
+    for (int i = 0; i < count; i++)
+        device_free(blocks[i]);
+
+    // Each allocation is given the smallest free block that can hold it.
+    void *p = device_malloc((large + 40) * DEVICE_HEAP_BLOCK_SIZE);
+    void *q = device_malloc((large + 5) * DEVICE_HEAP_BLOCK_SIZE);
+    void *r = device_malloc((large + 250) * DEVICE_HEAP_BLOCK_SIZE);
+
+    HOST_CHECK(p == blocks[3]);
+    HOST_CHECK(q == blocks[1]);
+    HOST_CHECK(r == blocks[2]);
+
+    device_free(p);
+    device_free(q);
+    device_free(r);
+
+    for (int i = 0; i < count; i++)
+        device_free(guards[i]);
+}
+#endif
+
+int main()
+{
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+    test_coalesce();
+    test_best_fit();
+#endif
+    test_realloc();
+    test_stats();
+    test_churn();
+
+    return host_test_result();
+}
@@ -0,0 +1,196 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of priority scheduling (DEVICE_FIBER_PRIORITY), and of priority aging (DEVICE_FIBER_PRIORITY_AGING).
+  * Without priorities, fibers are expected to run in the order they became runnable.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "HostTest.h"
+
+#include <string.h>
+
+using namespace codal;
+
+#define TEST_SPINS              40
+
+static char runLog[64];
+static int runLogLength = 0;
+
+static void record(char c)
+{
+    if (runLogLength < (int)sizeof(runLog) - 1)
+        runLog[runLogLength++] = c;
+
+    runLog[runLogLength] = 0;
+}
+
+static void reset()
+{
+    runLogLength = 0;
+    runLog[0] = 0;
+}
+
+static void tagged(void *p)
+{
+    record((char)(intptr_t)p);
+}
+
+static void yielding(void *p)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        record((char)(intptr_t)p);
+        schedule();
+    }
+}
+
+static void test_levels()
+{
+    reset();
+
+    // Made runnable lowest priority first...
+    create_fiber(tagged, (void *)'L', FIBER_PRIORITY_LOW);
+    create_fiber(tagged, (void *)'N', FIBER_PRIORITY_NORMAL);
+    create_fiber(tagged, (void *)'H', FIBER_PRIORITY_HIGH);
+    create_fiber(tagged, (void *)'R', FIBER_PRIORITY_REALTIME);
+
+    fiber_sleep(1);
+
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    // ... but run highest priority first.
+    HOST_CHECK(strcmp(runLog, "RHNL") == 0);
+#else
+    HOST_CHECK(strcmp(runLog, "LNHR") == 0);
+#endif
+}
+
+static void test_round_robin()
+{
+    reset();
+
+    // Fibers of the same level take turns, and a lower level only runs once they have all finished.
+    create_fiber(yielding, (void *)'l', FIBER_PRIORITY_LOW);
+    create_fiber(yielding, (void *)'a', FIBER_PRIORITY_HIGH);
+    create_fiber(yielding, (void *)'b', FIBER_PRIORITY_HIGH);
+
+    fiber_sleep(1);
+
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY) && DEVICE_FIBER_PRIORITY_AGING == 0
+    HOST_CHECK(strcmp(runLog, "ababablll") == 0);
+#elif !CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    HOST_CHECK(strcmp(runLog, "lablablab") == 0);
+#else
+    HOST_CHECK(runLogLength == 9);
+#endif
+}
+
+static int spins = 0;
+static int lowFirstRun = -1;
+
+static void spinner()
+{
+    for (int i = 0; i < TEST_SPINS; i++)
+    {
+        spins++;
+        schedule();
+    }
+}
+
+static void starved()
+{
+    lowFirstRun = spins;
+}
+
+static void test_aging()
+{
+    spins = 0;
+    lowFirstRun = -1;
+
+    // Two high priority fibers keep the scheduler busy, and so pass over a low priority fiber.
+    create_fiber(starved, FIBER_PRIORITY_LOW);
+    create_fiber(spinner, FIBER_PRIORITY_HIGH);
+    create_fiber(spinner, FIBER_PRIORITY_HIGH);
+
+    fiber_sleep(1);
+
+    HOST_CHECK(spins == 2 * TEST_SPINS);
+
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY) && DEVICE_FIBER_PRIORITY_AGING > 0
+    // The low priority fiber gets a turn within the aging bound, rather than once the spinners have finished.
+    HOST_CHECK(lowFirstRun >= 0 && lowFirstRun <= DEVICE_FIBER_PRIORITY_AGING);
+#elif CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    HOST_CHECK(lowFirstRun == 2 * TEST_SPINS);
+#else
+    HOST_CHECK(lowFirstRun == 0);
+#endif
+}
+
+static int blockerPriority = -1;
+static int parentPriority = -1;
+
+static void blocker()
+{
+    fiber_sleep(1);
+
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    blockerPriority = currentFiber->priority;
+#endif
+}
+
+static void parent()
+{
+    invoke(blocker);
+
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    parentPriority = currentFiber->priority;
+#endif
+}
+
+static void test_fork_on_block()
+{
+    // When an invoked call blocks, it is forked onto another fiber, which inherits the priority of the caller.
+    create_fiber(parent, FIBER_PRIORITY_HIGH);
+
+    fiber_sleep(5);
+
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    HOST_CHECK(parentPriority == FIBER_PRIORITY_HIGH);
+    HOST_CHECK(blockerPriority == FIBER_PRIORITY_HIGH);
+#endif
+}
+
+int main()
+{
+    host_test_init();
+
+    test_levels();
+    test_round_robin();
+    test_aging();
+    test_fork_on_block();
+
+    return host_test_result();
+}
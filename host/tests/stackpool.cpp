@@ -0,0 +1,83 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of the fiber stack buffers allocated as blocking calls are forked by invoke().
+  * With DEVICE_FIBER_STACK_POOL enabled, repeated blocking invokes reuse pooled buffers rather than the heap.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+#define TEST_ROUNDS             10
+#define TEST_BURST              12
+
+static int completed = 0;
+
+static void blocker()
+{
+    fiber_sleep(1);
+    completed++;
+}
+
+static void test_invoke()
+{
+#if CONFIG_ENABLED(DEVICE_FIBER_STACK_POOL)
+    uint32_t hits = fiber_stack_pool_hits();
+    uint32_t misses = fiber_stack_pool_misses();
+#endif
+
+    // Each invoke blocks, so is forked onto another fiber, which needs a stack buffer of its own. Only a few
+    // fibers are kept for reuse once they complete, so every burst frees and reallocates the rest of the buffers.
+    for (int i = 0; i < TEST_ROUNDS; i++)
+    {
+        for (int j = 0; j < TEST_BURST; j++)
+            HOST_CHECK(invoke(blocker) == DEVICE_OK);
+
+        fiber_sleep(2);
+    }
+
+    HOST_CHECK(completed == TEST_ROUNDS * TEST_BURST);
+
+#if CONFIG_ENABLED(DEVICE_FIBER_STACK_POOL)
+    hits = fiber_stack_pool_hits() - hits;
+    misses = fiber_stack_pool_misses() - misses;
+
+    // The first burst starts from an empty pool. Each later one reuses a full pool of buffers released by the last.
+    HOST_CHECK(misses >= TEST_BURST - 4);
+    HOST_CHECK(hits >= (TEST_ROUNDS - 1) * DEVICE_FIBER_STACK_POOL_DEPTH);
+#endif
+}
+
+int main()
+{
+    host_test_init();
+
+    test_invoke();
+
+    return host_test_result();
+}
@@ -0,0 +1,110 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of the per fiber CPU accounting (DEVICE_FIBER_STATISTICS) and the scheduler trace buffer
+  * (DEVICE_FIBER_TRACE_SIZE). Each is checked only in builds that enable it.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "ManagedBuffer.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+#define TEST_ROUNDS             5
+#define TEST_WORK_US            2000
+
+static volatile bool finished = false;
+static volatile bool released = false;
+
+static void worker()
+{
+    // Simulate a burst of work between each sleep, by moving simulated time on without yielding.
+    for (int i = 0; i < TEST_ROUNDS; i++)
+    {
+        target_wait_us(TEST_WORK_US);
+        fiber_sleep(1);
+    }
+
+    finished = true;
+
+    while (!released)
+        fiber_sleep(1);
+}
+
+static void test_statistics()
+{
+    Fiber *f = create_fiber(worker);
+
+    while (!finished)
+        fiber_sleep(1);
+
+#if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS)
+    // The worker was scheduled in once to start, and once after each sleep, and ran for at least its simulated work.
+    HOST_CHECK(f->switch_count >= TEST_ROUNDS + 1);
+    HOST_CHECK(f->run_time >= TEST_ROUNDS * TEST_WORK_US);
+    HOST_CHECK(f->max_stack_depth > 0);
+
+    // We spent the same period asleep.
+    HOST_CHECK(currentFiber->run_time < f->run_time);
+#else
+    (void)f;
+#endif
+
+    released = true;
+    fiber_sleep(2);
+}
+
+static void test_trace()
+{
+#if DEVICE_FIBER_TRACE_SIZE > 0
+    ManagedBuffer b = fiber_trace_buffer();
+    FiberTraceRecord *r = (FiberTraceRecord *)b.getBytes();
+    int count = b.length() / sizeof(FiberTraceRecord);
+
+    // The buffer is full by now, and holds the most recent switches, oldest first, each following on from the last.
+    HOST_CHECK(count == DEVICE_FIBER_TRACE_SIZE);
+
+    for (int i = 1; i < count; i++)
+    {
+        HOST_CHECK(r[i].timestamp >= r[i - 1].timestamp);
+        HOST_CHECK(r[i].from == r[i - 1].to);
+    }
+
+    // The last switch recorded is the one that scheduled us in.
+    HOST_CHECK(count > 0 && r[count - 1].to == currentFiber);
+#endif
+}
+
+int main()
+{
+    host_test_init();
+
+    test_statistics();
+    test_trace();
+
+    return host_test_result();
+}
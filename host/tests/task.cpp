@@ -0,0 +1,178 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of stackless tasks (see CodalTask.h), and of how they share the NOTIFY channel with fibers.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "CodalTask.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "NotifyEvents.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+#define TEST_EVENT_ID           9200
+#define TEST_NOTIFY_VALUE       43
+
+struct CountingTask : Task
+{
+    int count;
+};
+
+static CountingTask sleeper;
+static CountingTask waiter;
+static CountingTask notifyTask;
+static int fiberNotified = 0;
+
+static int sleep_task(Task *t)
+{
+    CountingTask *c = (CountingTask *)t;
+
+    TASK_BEGIN(t);
+
+    for (c->count = 0; c->count < 10; c->count++)
+        TASK_SLEEP(t, 10);
+
+    TASK_END(t);
+}
+
+static int wait_task(Task *t)
+{
+    CountingTask *c = (CountingTask *)t;
+
+    TASK_BEGIN(t);
+
+    for (c->count = 0; c->count < 3; c->count++)
+        TASK_WAIT_FOR_EVENT(t, TEST_EVENT_ID, 1);
+
+    TASK_END(t);
+}
+
+static int notify_task(Task *t)
+{
+    CountingTask *c = (CountingTask *)t;
+
+    TASK_BEGIN(t);
+
+    c->count = 0;
+    TASK_WAIT_FOR_EVENT(t, DEVICE_ID_NOTIFY, TEST_NOTIFY_VALUE);
+    c->count = 1;
+
+    TASK_END(t);
+}
+
+static void notifyWaiter()
+{
+    fiber_wait_for_event(DEVICE_ID_NOTIFY, TEST_NOTIFY_VALUE);
+    fiberNotified++;
+}
+
+static void test_sleep()
+{
+    HOST_CHECK(task_start(&sleeper, sleep_task) == DEVICE_OK);
+    HOST_CHECK(task_start(&sleeper, sleep_task) == DEVICE_BUSY);
+
+    fiber_sleep(55);
+    HOST_CHECK(sleeper.count >= 4 && sleeper.count <= 6);
+
+    fiber_sleep(100);
+    HOST_CHECK(sleeper.count == 10);
+    HOST_CHECK(!task_running(&sleeper));
+}
+
+static void test_wait()
+{
+    task_start(&waiter, wait_task);
+    fiber_sleep(1);
+
+    // Only the event waited on wakes the task.
+    Event(TEST_EVENT_ID, 2);
+    fiber_sleep(1);
+    HOST_CHECK(waiter.count == 0);
+
+    for (int i = 0; i < 3; i++)
+    {
+        Event(TEST_EVENT_ID, 1);
+        fiber_sleep(1);
+    }
+
+    HOST_CHECK(waiter.count == 3);
+    HOST_CHECK(!task_running(&waiter));
+}
+
+static void test_notify_one()
+{
+    // The task starts waiting before the fiber does, but fibers are always notified first.
+    task_start(&notifyTask, notify_task);
+    fiber_sleep(1);
+    create_fiber(notifyWaiter);
+    fiber_sleep(1);
+
+    // Each NOTIFY_ONE event wakes exactly one waiter, whether a fiber or a task.
+    Event(DEVICE_ID_NOTIFY_ONE, TEST_NOTIFY_VALUE);
+    fiber_sleep(1);
+    HOST_CHECK(fiberNotified == 1);
+    HOST_CHECK(notifyTask.count == 0);
+
+    Event(DEVICE_ID_NOTIFY_ONE, TEST_NOTIFY_VALUE);
+    fiber_sleep(1);
+    HOST_CHECK(fiberNotified == 1);
+    HOST_CHECK(notifyTask.count == 1);
+
+    // With no one left waiting, a further event is simply dropped.
+    Event(DEVICE_ID_NOTIFY_ONE, TEST_NOTIFY_VALUE);
+    fiber_sleep(1);
+    HOST_CHECK(fiberNotified == 1);
+}
+
+static void test_stop()
+{
+    task_start(&waiter, wait_task);
+    fiber_sleep(1);
+
+    HOST_CHECK(task_stop(&waiter) == DEVICE_OK);
+    HOST_CHECK(!task_running(&waiter));
+
+    // A stopped task is no longer woken.
+    Event(TEST_EVENT_ID, 1);
+    fiber_sleep(1);
+    HOST_CHECK(waiter.count == 0);
+}
+
+int main()
+{
+    host_test_init();
+
+    test_sleep();
+    test_wait();
+    test_notify_one();
+    test_stop();
+
+    return host_test_result();
+}
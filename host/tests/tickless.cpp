@@ -0,0 +1,156 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of the wake up of sleeping fibers, and of the interrupts the scheduler takes to do so.
+  * These pass whether or not SCHEDULER_TICKLESS is enabled. In tickless mode, a mostly idle device
+  * must take next to no timer interrupts.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "CodalComponent.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+// The interrupt handler of the Timer (see Timer.cpp).
+void timer_callback(uint16_t chan);
+
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+#define TEST_WAKE_LATENCY_MS    0
+#else
+#define TEST_WAKE_LATENCY_MS    (SCHEDULER_TICK_PERIOD_US / 1000 + 1)
+#endif
+
+/**
+  * A component that asks for the periodic callback.
+  */
+class TickingComponent : public CodalComponent
+{
+    public:
+
+    int ticks;
+
+    TickingComponent() : ticks(0)
+    {
+        status |= DEVICE_COMPONENT_STATUS_SYSTEM_TICK;
+    }
+
+    virtual void periodicCallback()
+    {
+        ticks++;
+    }
+};
+
+static int interrupts = 0;
+
+static const int sleepPeriods[3] = { 5, 37, 120 };
+static CODAL_TIMESTAMP wakeTimes[3];
+static int wakeCount = 0;
+
+static void counting_timer_callback(uint16_t chan)
+{
+    interrupts++;
+    timer_callback(chan);
+}
+
+static void sleeper(void *p)
+{
+    int n = (int)(intptr_t)p;
+
+    fiber_sleep(sleepPeriods[n]);
+    wakeTimes[n] = system_timer_current_time();
+    wakeCount++;
+}
+
+static void test_wake()
+{
+    CODAL_TIMESTAMP start = system_timer_current_time();
+
+    // Started latest first, so that each new sleeper is due before those already sleeping.
+    for (int i = 2; i >= 0; i--)
+        create_fiber(sleeper, (void *)(intptr_t)i);
+
+    fiber_sleep(200);
+
+    HOST_CHECK(wakeCount == 3);
+
+    for (int i = 0; i < 3; i++)
+    {
+        HOST_CHECK(wakeTimes[i] >= start + sleepPeriods[i]);
+        HOST_CHECK(wakeTimes[i] <= start + sleepPeriods[i] + TEST_WAKE_LATENCY_MS);
+    }
+}
+
+static void test_idle()
+{
+    interrupts = 0;
+
+    // With nothing else to do, a ticking scheduler is interrupted every tick period...
+    fiber_sleep(10000);
+
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+    // ... but a tickless one only to wake us.
+    HOST_CHECK(interrupts <= 2);
+#else
+    HOST_CHECK(interrupts >= 10000000 / SCHEDULER_TICK_PERIOD_US - 1);
+#endif
+}
+
+static void test_component()
+{
+    static TickingComponent *component = new TickingComponent();
+
+    // Components that ask for the periodic callback receive it in either mode...
+    fiber_sleep(100);
+    HOST_CHECK(component->ticks >= 100000 / SCHEDULER_TICK_PERIOD_US - 2);
+
+    // ... and once none do, a tickless scheduler stops the periodic timer.
+    component->status &= ~DEVICE_COMPONENT_STATUS_SYSTEM_TICK;
+    fiber_sleep(SCHEDULER_TICK_PERIOD_US / 1000 * 2);
+
+    interrupts = 0;
+    fiber_sleep(1000);
+
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+    HOST_CHECK(interrupts <= 2);
+#endif
+}
+
+int main()
+{
+    host_test_init();
+
+    lowLevelTimer->setIRQ(counting_timer_callback);
+
+    test_wake();
+    test_idle();
+    test_component();
+
+    return host_test_result();
+}
@@ -0,0 +1,108 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of the timer event list of Timer.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+#define TEST_EVENT_ID           7000
+
+static int fired = 0;
+static int outOfOrder = 0;
+static CODAL_TIMESTAMP lastFired = 0;
+static int firedValue[64];
+
+static void onTimer(Event e)
+{
+    if (e.timestamp < lastFired)
+        outOfOrder++;
+
+    lastFired = e.timestamp;
+    firedValue[fired++ % 64] = e.value;
+}
+
+static void test_order()
+{
+    fired = 0;
+    lastFired = 0;
+    srand(7);
+
+    // Events fire in order of their due time, whatever the order they were set in.
+    for (int i = 0; i < 40; i++)
+        while (timer->eventAfterUs(1000 + rand() % 50000, TEST_EVENT_ID, i + 1) != DEVICE_OK)
+            fiber_sleep(0);
+
+    // Cancelled events never fire, wherever they are in the list.
+    HOST_CHECK(timer->cancel(TEST_EVENT_ID, 1) == DEVICE_OK);
+    HOST_CHECK(timer->cancel(TEST_EVENT_ID, 20) == DEVICE_OK);
+    HOST_CHECK(timer->cancel(TEST_EVENT_ID, 20) == DEVICE_INVALID_PARAMETER);
+
+    fiber_sleep(100);
+
+    HOST_CHECK(fired == 38);
+    HOST_CHECK(outOfOrder == 0);
+
+    for (int i = 0; i < fired; i++)
+        HOST_CHECK(firedValue[i] != 1 && firedValue[i] != 20);
+}
+
+static void test_growth()
+{
+    int set = 0;
+
+    // The list is never grown by setEvent() itself, as it may be called from an interrupt. So setting events
+    // without yielding eventually fails...
+    while (set < 1000 && timer->eventAfterUs(1000000, TEST_EVENT_ID + 1, set) == DEVICE_OK)
+        set++;
+
+    HOST_CHECK(set < 1000);
+
+    // ... until the scheduler has had a chance to grow it in thread context.
+    fiber_sleep(0);
+    HOST_CHECK(timer->eventAfterUs(1000000, TEST_EVENT_ID + 1, set) == DEVICE_OK);
+
+    for (int i = 0; i <= set; i++)
+        HOST_CHECK(timer->cancel(TEST_EVENT_ID + 1, i) == DEVICE_OK);
+}
+
+int main()
+{
+    host_test_init();
+
+    bus->listen(TEST_EVENT_ID, DEVICE_EVT_ANY, onTimer, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+    test_order();
+    test_growth();
+
+    return host_test_result();
+}
@@ -0,0 +1,147 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Tests of fibers blocking on events (see fiber_wait_for_event()).
+  * These pass whether or not SCHEDULER_LISTEN_ALL_EVENTS and DEVICE_FIBER_WAIT_INDEX are enabled.
+  */
+
+#include "CodalConfig.h"
+#include "CodalFiber.h"
+#include "MessageBus.h"
+#include "Timer.h"
+#include "HostLowLevelTimer.h"
+#include "NotifyEvents.h"
+#include "HostTest.h"
+
+using namespace codal;
+
+#define TEST_EVENT_ID           9000
+#define TEST_LAZY_ID            9100
+#define TEST_NOTIFY_VALUE       42
+
+static int woken[4];
+static int notified[3];
+static int notifyOrder[3];
+static int notifyCount = 0;
+static int lazyListened = 0;
+
+static void waiter(void *p)
+{
+    int n = (int)(intptr_t)p;
+
+    // n.b. a value of zero is DEVICE_EVT_ANY, so wait on values 1 and 2.
+    for (int i = 0; i < 50; i++)
+    {
+        fiber_wait_for_event(TEST_EVENT_ID, 1 + n % 2);
+        woken[n]++;
+    }
+}
+
+static void notifyWaiter(void *p)
+{
+    int n = (int)(intptr_t)p;
+
+    fiber_wait_for_event(DEVICE_ID_NOTIFY, TEST_NOTIFY_VALUE);
+    notified[n]++;
+    notifyOrder[notifyCount++] = n;
+}
+
+static void lazyWaiter()
+{
+    fiber_wait_for_event(TEST_LAZY_ID, 1);
+}
+
+static void onListener(Event e)
+{
+    if (e.value == TEST_LAZY_ID)
+        lazyListened++;
+}
+
+static void test_wake()
+{
+    for (int i = 0; i < 4; i++)
+        create_fiber(waiter, (void *)(intptr_t)i);
+
+    fiber_sleep(1);
+
+    // Every fiber waiting on an event is woken by it, and only by it.
+    for (int r = 0; r < 50; r++)
+    {
+        Event(TEST_EVENT_ID, 1);
+        fiber_sleep(1);
+        Event(TEST_EVENT_ID, 2);
+        fiber_sleep(1);
+    }
+
+    for (int i = 0; i < 4; i++)
+        HOST_CHECK(woken[i] == 50);
+}
+
+static void test_notify_one()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        create_fiber(notifyWaiter, (void *)(intptr_t)i);
+        fiber_sleep(1);
+    }
+
+    // Each NOTIFY_ONE event wakes a single fiber, the one that has waited longest.
+    for (int i = 0; i < 3; i++)
+    {
+        Event(DEVICE_ID_NOTIFY_ONE, TEST_NOTIFY_VALUE);
+        fiber_sleep(1);
+
+        HOST_CHECK(notifyCount == i + 1);
+        HOST_CHECK(notifyOrder[i] == i);
+    }
+
+    for (int i = 0; i < 3; i++)
+        HOST_CHECK(notified[i] == 1);
+}
+
+static void test_listener_event()
+{
+    bus->listen(DEVICE_ID_MESSAGE_BUS_LISTENER, DEVICE_EVT_ANY, onListener);
+
+    // Components that start up once something listens to them must also see fibers that wait on them.
+    create_fiber(lazyWaiter);
+    fiber_sleep(1);
+
+    HOST_CHECK(lazyListened >= 1);
+
+    Event(TEST_LAZY_ID, 1);
+    fiber_sleep(1);
+}
+
+int main()
+{
+    host_test_init();
+
+    test_wake();
+    test_notify_one();
+    test_listener_event();
+
+    return host_test_result();
+}
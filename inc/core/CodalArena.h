@@ -0,0 +1,105 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef CODAL_ARENA_H
+#define CODAL_ARENA_H
+
+#include "CodalConfig.h"
+
+namespace codal
+{
+    /**
+      * A region based allocator, for objects that share a lifetime.
+      *
+      * An arena draws memory from the heap in chunks, and hands it out by simply advancing a pointer through
+      * the current chunk. Objects allocated from an arena are never freed individually. Instead, all of them
+      * are freed at once when the arena is reset or destroyed. This makes allocation very cheap, and keeps
+      * groups of small, long lived objects from fragmenting the heap, as they occupy a few large blocks
+      * rather than many small ones scattered among other allocations.
+      *
+      * An arena is not safe to use from interrupt context.
+      *
+      * @code
+      * Arena arena;
+      *
+      * Entry *e = (Entry *) arena.allocate(sizeof(Entry));
+      * ...
+      * arena.reset();      // Frees e, and everything else allocated from the arena.
+      * @endcode
+      */
+    class Arena
+    {
+        struct ArenaChunk
+        {
+            ArenaChunk  *next;          // The previously allocated chunk.
+            uint16_t    size;           // The number of bytes available for allocation in this chunk.
+            uint16_t    used;           // The number of bytes allocated from this chunk.
+        };
+
+        ArenaChunk      *chunks;        // The chunk currently being allocated from, followed by those filled earlier.
+        uint16_t        chunkSize;      // The number of bytes to request from the heap for each chunk.
+
+        public:
+
+        /**
+          * Constructor. Creates an empty arena. No memory is allocated until the first allocation is made.
+          *
+          * @param chunkSize The number of bytes to draw from the heap at a time. Allocations larger than this
+          *                  are given a chunk of their own. Defaults to CODAL_ARENA_CHUNK_SIZE.
+          */
+        Arena(uint16_t chunkSize = CODAL_ARENA_CHUNK_SIZE);
+
+        /**
+          * Destructor. Frees all memory allocated from the arena.
+          */
+        ~Arena();
+
+        /**
+          * Allocates memory from the arena. The memory remains valid until the arena is reset or destroyed.
+          *
+          * @param size The number of bytes required.
+          *
+          * @return A pointer to the memory allocated, or NULL if there is insufficient memory.
+          */
+        void *allocate(size_t size);
+
+        /**
+          * Frees all memory allocated from the arena, returning its chunks to the heap.
+          */
+        void reset();
+
+        /**
+          * Determines the number of bytes allocated from the arena.
+          */
+        uint32_t getUsed();
+
+        /**
+          * Determines the number of bytes the arena has drawn from the heap.
+          */
+        uint32_t getSize();
+    };
+}
+
+#endif
@@ -0,0 +1,362 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  * Typed event channels.
+  *
+  * A Channel carries structured payloads from producers to subscribers, layered on the EventModel.
+  * Subscribers register with the channel itself, so are resolved once, at registration. Publishing a payload
+  * then raises a single event, handled by one listener that hands the payload to each subscriber in turn.
+  *
+  * Payloads are held in a small fixed pool within the channel. A producer acquires a slot, fills it in place,
+  * and publishes it. Subscribers receive a reference to the same slot, which is returned to the pool once they
+  * have all returned, so the payload is never copied. If all slots are in use, acquire() fails, and the payload
+  * is dropped.
+  *
+  * @code
+  * Channel<Sample3D> samples(3000);       // Any event id not otherwise in use.
+  *
+  * void onSample(const Sample3D &s, void *)
+  * {
+  *     // do something with s.x, s.y and s.z
+  * }
+  *
+  * samples.subscribe(onSample);
+  *
+  * // in the producer...
+  * Sample3D *s = samples.acquire();
+  * if (s)
+  * {
+  *     s->x = x; s->y = y; s->z = z;
+  *     samples.publish(s);
+  * }
+  * @endcode
+  */
+#ifndef CODAL_CHANNEL_H
+#define CODAL_CHANNEL_H
+
+#include "CodalConfig.h"
+#include "ErrorNo.h"
+#include "EventModel.h"
+#include "codal_target_hal.h"
+
+// The event raised on the id of a channel when a payload is published.
+#define DEVICE_CHANNEL_EVT_PUBLISHED        1
+
+// States of the payload slots of a channel.
+#define DEVICE_CHANNEL_SLOT_FREE            0
+#define DEVICE_CHANNEL_SLOT_ACQUIRED        1
+#define DEVICE_CHANNEL_SLOT_PUBLISHED       2
+
+namespace codal
+{
+    /**
+      * A typed event channel.
+      *
+      * @tparam Payload The type of the payloads carried. Must be default constructible and assignable.
+      *
+      * @tparam Slots The number of payloads that may be acquired or waiting to be delivered at once, up to 255.
+      *
+      * @tparam MaxSubscribers The number of subscribers the channel can hold.
+      */
+    template <typename Payload, int Slots = 4, int MaxSubscribers = 4>
+    class Channel
+    {
+        Payload         payloads[Slots];                        // The payload pool.
+        uint8_t         state[Slots];                           // The DEVICE_CHANNEL_SLOT state of each payload.
+        uint8_t         published[Slots];                       // The indices of the published payloads, in order of publication.
+        uint8_t         publishedHead;                          // The index of the oldest entry in published.
+        uint8_t         publishedLength;                        // The number of entries in published.
+        uint8_t         subscriberCount;                        // The number of entries in subscribers.
+        bool            listening;                              // true once the channel is listening for its own events.
+        uint16_t        id;                                     // The event id used by the channel.
+        uint32_t        dropped;                                // The number of payloads that could not be acquired.
+
+        struct
+        {
+            void (*handler)(const Payload &, void *);
+            void *context;
+        } subscribers[MaxSubscribers];
+
+        /**
+          * Hands each published payload to all subscribers, oldest first, and returns it to the pool.
+          */
+        void dispatch(Event)
+        {
+            while (1)
+            {
+                int slot;
+
+                target_disable_irq();
+
+                if (publishedLength == 0)
+                {
+                    target_enable_irq();
+                    return;
+                }
+
+                slot = published[publishedHead];
+                publishedHead = (publishedHead + 1) % Slots;
+                publishedLength--;
+
+                target_enable_irq();
+
+                for (int i = 0; i < subscriberCount; i++)
+                    subscribers[i].handler(payloads[slot], subscribers[i].context);
+
+                release(&payloads[slot]);
+            }
+        }
+
+        public:
+
+        /**
+          * Constructor. Creates a channel with no subscribers.
+          *
+          * @param id The event id used to signal that payloads have been published. This should be unique to the channel.
+          */
+        Channel(uint16_t id)
+        {
+            this->id = id;
+            this->publishedHead = 0;
+            this->publishedLength = 0;
+            this->subscriberCount = 0;
+            this->listening = false;
+            this->dropped = 0;
+
+            for (int i = 0; i < Slots; i++)
+                state[i] = DEVICE_CHANNEL_SLOT_FREE;
+        }
+
+        /**
+          * Destructor. Stops listening for the events of the channel, and releases its coalescing entry on the event bus.
+          */
+        ~Channel()
+        {
+            if (listening && EventModel::defaultEventBus)
+            {
+                EventModel::defaultEventBus->ignore(id, DEVICE_CHANNEL_EVT_PUBLISHED, this, &Channel::dispatch);
+                EventModel::defaultEventBus->setCoalescing(id, DEVICE_CHANNEL_EVT_PUBLISHED, false);
+            }
+        }
+
+        /**
+          * Registers a subscriber. Subscribers are called in the order they subscribed, in the context of a
+          * standard (non-urgent) listener, so may block. The payload is only valid until the subscriber returns.
+          *
+          * @param handler The function to call with each payload published.
+          *
+          * @param context An optional parameter passed to the handler.
+          *
+          * @return DEVICE_OK, DEVICE_INVALID_PARAMETER if handler is NULL, DEVICE_NO_RESOURCES if the channel already
+          *         has MaxSubscribers subscribers or the event bus cannot coalesce the events of another channel
+          *         (see MESSAGE_BUS_COALESCE_MAX), or DEVICE_NOT_SUPPORTED if there is no default EventModel, or it
+          *         does not support coalescing.
+          *
+          * @note Each channel with subscribers holds one of the MESSAGE_BUS_COALESCE_MAX coalescing entries of the
+          *       event bus until it is destroyed.
+          */
+        int subscribe(void (*handler)(const Payload &, void *), void *context = NULL)
+        {
+            if (handler == NULL)
+                return DEVICE_INVALID_PARAMETER;
+
+            if (subscriberCount >= MaxSubscribers)
+                return DEVICE_NO_RESOURCES;
+
+            if (!listening)
+            {
+                if (EventModel::defaultEventBus == NULL)
+                    return DEVICE_NOT_SUPPORTED;
+
+                // A single pending event is enough to deliver every published payload, so it can be coalesced.
+                // Without this, a burst of publications could fill the event queue, so treat failure as an error.
+                int result = EventModel::defaultEventBus->setCoalescing(id, DEVICE_CHANNEL_EVT_PUBLISHED, true);
+
+                if (result != DEVICE_OK)
+                    return result;
+
+                result = EventModel::defaultEventBus->listen(id, DEVICE_CHANNEL_EVT_PUBLISHED, this, &Channel::dispatch);
+
+                if (result != DEVICE_OK)
+                {
+                    EventModel::defaultEventBus->setCoalescing(id, DEVICE_CHANNEL_EVT_PUBLISHED, false);
+                    return result;
+                }
+
+                listening = true;
+            }
+
+            subscribers[subscriberCount].handler = handler;
+            subscribers[subscriberCount].context = context;
+            subscriberCount++;
+
+            return DEVICE_OK;
+        }
+
+        /**
+          * Removes a subscriber.
+          *
+          * @param handler The handler given to subscribe().
+          *
+          * @param context The context given to subscribe().
+          *
+          * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if there is no such subscriber.
+          */
+        int unsubscribe(void (*handler)(const Payload &, void *), void *context = NULL)
+        {
+            for (int i = 0; i < subscriberCount; i++)
+            {
+                if (subscribers[i].handler == handler && subscribers[i].context == context)
+                {
+                    for (int j = i + 1; j < subscriberCount; j++)
+                        subscribers[j - 1] = subscribers[j];
+
+                    subscriberCount--;
+                    return DEVICE_OK;
+                }
+            }
+
+            return DEVICE_INVALID_PARAMETER;
+        }
+
+        /**
+          * Acquires a free payload from the pool, to be filled in and then published.
+          * This function may be called from interrupt context.
+          *
+          * @return The payload, or NULL if all payloads are in use.
+          */
+        Payload *acquire()
+        {
+            Payload *p = NULL;
+
+            target_disable_irq();
+
+            for (int i = 0; i < Slots && p == NULL; i++)
+            {
+                if (state[i] == DEVICE_CHANNEL_SLOT_FREE)
+                {
+                    state[i] = DEVICE_CHANNEL_SLOT_ACQUIRED;
+                    p = &payloads[i];
+                }
+            }
+
+            if (p == NULL)
+                dropped++;
+
+            target_enable_irq();
+
+            return p;
+        }
+
+        /**
+          * Publishes a payload previously returned by acquire(). The channel takes ownership of the payload.
+          * If the channel has no subscribers, the payload is simply released.
+          * This function may be called from interrupt context.
+          *
+          * @param p The payload to publish.
+          *
+          * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if p was not acquired from this channel.
+          */
+        int publish(Payload *p)
+        {
+            int slot = p - payloads;
+
+            if (slot < 0 || slot >= Slots || state[slot] != DEVICE_CHANNEL_SLOT_ACQUIRED)
+                return DEVICE_INVALID_PARAMETER;
+
+            if (subscriberCount == 0)
+                return release(p);
+
+            target_disable_irq();
+
+            state[slot] = DEVICE_CHANNEL_SLOT_PUBLISHED;
+            published[(publishedHead + publishedLength) % Slots] = slot;
+            publishedLength++;
+
+            target_enable_irq();
+
+            Event(id, DEVICE_CHANNEL_EVT_PUBLISHED);
+
+            return DEVICE_OK;
+        }
+
+        /**
+          * Copies the given payload into the pool, and publishes it.
+          * This function may be called from interrupt context.
+          *
+          * @param payload The payload to publish.
+          *
+          * @return DEVICE_OK, or DEVICE_NO_RESOURCES if all payloads are in use, in which case the payload is dropped.
+          */
+        int publish(const Payload &payload)
+        {
+            Payload *p = acquire();
+
+            if (p == NULL)
+                return DEVICE_NO_RESOURCES;
+
+            *p = payload;
+
+            return publish(p);
+        }
+
+        /**
+          * Returns a payload to the pool, without publishing it.
+          *
+          * @param p A payload previously returned by acquire().
+          *
+          * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if p is not a payload of this channel.
+          */
+        int release(Payload *p)
+        {
+            int slot = p - payloads;
+
+            if (slot < 0 || slot >= Slots)
+                return DEVICE_INVALID_PARAMETER;
+
+            // Drop any references the payload holds (e.g. to a ManagedBuffer).
+            *p = Payload();
+
+            target_disable_irq();
+            state[slot] = DEVICE_CHANNEL_SLOT_FREE;
+            target_enable_irq();
+
+            return DEVICE_OK;
+        }
+
+        /**
+          * Determines the number of payloads dropped as the pool was exhausted.
+          *
+          * @return The number of calls to acquire() that failed.
+          */
+        uint32_t getDroppedCount()
+        {
+            return dropped;
+        }
+    };
+}
+
+#endif
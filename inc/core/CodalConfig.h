@@ -57,6 +57,14 @@ DEALINGS IN THE SOFTWARE.
 #define DEVICE_HEAP_ALLOCATOR                 1
 #endif
 
+// Enables the DeviceHeapAllocator to replace the C library heap (malloc, free, realloc and calloc).
+// If disabled, the DeviceHeapAllocator is only used through device_malloc(), device_free() and device_realloc(),
+// which allows it to run alongside a C library heap that the rest of the environment still depends upon.
+// Set '1' to enable.
+#ifndef DEVICE_HEAP_REPLACE_LIBC
+#define DEVICE_HEAP_REPLACE_LIBC              1
+#endif
+
 //
 // The CODAL heap allocator supports the use of multiple, independent heap regions if needed.
 // This defines the maximum number of heap regions permitted.
@@ -66,12 +74,72 @@ DEALINGS IN THE SOFTWARE.
 #define DEVICE_MAXIMUM_HEAPS                  1
 #endif
 
+//
+// Enables caches of recently freed heap blocks, segregated by size class. Allocations of up to
+// (8 * DEVICE_HEAP_CACHE_CLASSES) bytes are rounded up to a multiple of 8 bytes, and are served from the cache
+// of their class if possible. This takes one short critical section, rather than a first fit walk of the heap
+// with interrupts disabled. Up to DEVICE_HEAP_CACHE_DEPTH freed blocks are held in each class. Should a search of
+// the heap fail, a larger cached block is used if there is one, otherwise all cached blocks are returned to the heap
+// and it is searched once more.
+// Set '1' to enable.
+//
+#ifndef DEVICE_HEAP_CACHE
+#define DEVICE_HEAP_CACHE                     0
+#endif
+
+#ifndef DEVICE_HEAP_CACHE_CLASSES
+#define DEVICE_HEAP_CACHE_CLASSES             16
+#endif
+
+#ifndef DEVICE_HEAP_CACHE_DEPTH
+#define DEVICE_HEAP_CACHE_DEPTH               4
+#endif
+
+//
+// Replaces the first fit walk of the heap with segregated free lists. Each free block links to the other free blocks
+// of its size class, and repeats its size in its last word, so that device_free() can merge it with free neighbours on
+// both sides straight away. Free blocks smaller than (4 << DEVICE_HEAP_SEGREGATED_CLASSES) words are kept in lists
+// of power of two size classes, and larger ones in a binary search tree ordered by size. Allocations take at
+// least four words, including the index block, so that they can hold these links once freed.
+// Set '1' to enable.
+//
+#ifndef DEVICE_HEAP_SEGREGATED
+#define DEVICE_HEAP_SEGREGATED                0
+#endif
+
+#ifndef DEVICE_HEAP_SEGREGATED_CLASSES
+#define DEVICE_HEAP_SEGREGATED_CLASSES        6
+#endif
+
 // If enabled, RefCounted objects include a constant tag at the beginning.
 // Set '1' to enable.
 #ifndef DEVICE_TAG
 #define DEVICE_TAG                            0
 #endif
 
+// Enables pooling of the payloads of RefCounted types (the data held by ManagedBuffer, ManagedString and Image).
+// Payloads are allocated from REF_COUNTED_POOL_CLASSES MemoryPools, holding up to REF_COUNTED_POOL_MIN_SIZE bytes
+// of data in the first class, and doubling for each class thereafter. Each pool holds REF_COUNTED_POOL_SIZE payloads,
+// and is allocated the first time it is used. Payloads are returned to their pool when their last reference is
+// dropped, so steady state streaming of equally sized buffers does not touch the heap. Larger payloads, and those
+// allocated while a pool is full, are allocated from the heap as usual. See RefCounted::allocate().
+// Set '1' to enable.
+#ifndef REF_COUNTED_POOL
+#define REF_COUNTED_POOL                      0
+#endif
+
+#ifndef REF_COUNTED_POOL_MIN_SIZE
+#define REF_COUNTED_POOL_MIN_SIZE             32
+#endif
+
+#ifndef REF_COUNTED_POOL_CLASSES
+#define REF_COUNTED_POOL_CLASSES              5
+#endif
+
+#ifndef REF_COUNTED_POOL_SIZE
+#define REF_COUNTED_POOL_SIZE                 4
+#endif
+
 #ifndef CODAL_TIMESTAMP
 #define CODAL_TIMESTAMP                       uint32_t
 #endif
@@ -95,6 +163,99 @@ DEALINGS IN THE SOFTWARE.
 #define SCHEDULER_TICK_PERIOD_US                   6000
 #endif
 
+// Enables tickless operation of the scheduler.
+// When enabled, no periodic scheduler tick is generated. Instead, a single timer event is armed for
+// the earliest sleeping fiber, and the periodic component callback only runs whilst at least one
+// component has requested it (DEVICE_COMPONENT_STATUS_SYSTEM_TICK). Such requests are picked up the next time the scheduler idles.
+// Set '1' to enable.
+#ifndef SCHEDULER_TICKLESS
+#define SCHEDULER_TICKLESS                         0
+#endif
+
+// Registers the scheduler once as an immediate listener for every event, rather than registering a listener for
+// each event that a fiber (or task) waits on, and removing it once the event is raised. This makes each wait cheaper,
+// but every event raised is then passed to the scheduler, whether or not anything waits on it.
+// Waiting on an event still raises DEVICE_ID_MESSAGE_BUS_LISTENER for its id, as registering a listener would.
+// Set '1' to enable.
+#ifndef SCHEDULER_LISTEN_ALL_EVENTS
+#define SCHEDULER_LISTEN_ALL_EVENTS                0
+#endif
+
+// The number of calls that can be waiting on the deferred call queue (see fiber_defer()).
+// Each entry costs two words and a byte of RAM. Drivers may reserve slots for their own use (see fiber_defer_reserve()).
+#ifndef SCHEDULER_DEFERRED_QUEUE_SIZE
+#define SCHEDULER_DEFERRED_QUEUE_SIZE              8
+#endif
+
+// Enables O(1) enqueue and dequeue operations on all fiber queues (run, sleep, wait, pool and FiberLock queues).
+// When enabled, the head of each queue holds a reference to its tail in its qprev field, so waking large
+// numbers of fibers no longer requires a scan of the destination queue for each fiber. This costs no additional RAM.
+// Set '1' to enable.
+#ifndef DEVICE_FIBER_QUEUE_TAIL
+#define DEVICE_FIBER_QUEUE_TAIL                    0
+#endif
+
+// Enables an index of fibers blocked in fiber_wait_for_event(), keyed by event id and value.
+// When enabled, an event only visits the fibers that could match it (plus any waiting on wildcards),
+// rather than every blocked fiber. DEVICE_FIBER_WAIT_INDEX_SIZE defines the number of hash buckets.
+// Set '1' to enable.
+#ifndef DEVICE_FIBER_WAIT_INDEX
+#define DEVICE_FIBER_WAIT_INDEX                    0
+#endif
+
+#ifndef DEVICE_FIBER_WAIT_INDEX_SIZE
+#define DEVICE_FIBER_WAIT_INDEX_SIZE               8
+#endif
+
+// Enables priority scheduling of fibers. See FiberPriority and create_fiber().
+// When enabled, a run queue is maintained for each priority level, and the scheduler always selects
+// from the highest priority level that has runnable fibers.
+// Set '1' to enable.
+#ifndef DEVICE_FIBER_PRIORITY
+#define DEVICE_FIBER_PRIORITY                      0
+#endif
+
+// If non-zero, lower priority fibers are given a turn after this many consecutive scheduling decisions
+// have passed over them, such that they never starve completely. Real time fibers are never passed over.
+#ifndef DEVICE_FIBER_PRIORITY_AGING
+#define DEVICE_FIBER_PRIORITY_AGING                0
+#endif
+
+// Enables per fiber CPU accounting. When enabled, each Fiber records its cumulative run time in microseconds,
+// the number of times it has been scheduled in, and the deepest stack observed when it was scheduled out.
+// See fiber_statistics_dump().
+// Set '1' to enable.
+#ifndef DEVICE_FIBER_STATISTICS
+#define DEVICE_FIBER_STATISTICS                    0
+#endif
+
+// Number of context switches retained in the scheduler trace buffer. See fiber_trace_dump() and fiber_trace_buffer().
+// Set to '0' to disable.
+#ifndef DEVICE_FIBER_TRACE_SIZE
+#define DEVICE_FIBER_TRACE_SIZE                    0
+#endif
+
+// Enables pooling of fiber stack buffers by size class, to reduce heap churn when fibers are created,
+// released or grow their stack. Stack buffers are then allocated in DEVICE_FIBER_STACK_POOL_CLASSES size classes,
+// doubling from DEVICE_FIBER_STACK_POOL_MIN_SIZE bytes, and up to DEVICE_FIBER_STACK_POOL_DEPTH free buffers
+// of each class are retained for reuse. Larger stacks are allocated from the heap as usual.
+// Set '1' to enable.
+#ifndef DEVICE_FIBER_STACK_POOL
+#define DEVICE_FIBER_STACK_POOL                    0
+#endif
+
+#ifndef DEVICE_FIBER_STACK_POOL_MIN_SIZE
+#define DEVICE_FIBER_STACK_POOL_MIN_SIZE           128
+#endif
+
+#ifndef DEVICE_FIBER_STACK_POOL_CLASSES
+#define DEVICE_FIBER_STACK_POOL_CLASSES            4
+#endif
+
+#ifndef DEVICE_FIBER_STACK_POOL_DEPTH
+#define DEVICE_FIBER_STACK_POOL_DEPTH              4
+#endif
+
 #ifndef DEVICE_FIBER_USER_DATA
 #define DEVICE_FIBER_USER_DATA                     1
 #endif
@@ -107,6 +268,7 @@ DEALINGS IN THE SOFTWARE.
 //   MESSAGE_BUS_LISTENER_REENTRANT
 //   MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY
 //   MESSAGE_BUS_LISTENER_DROP_IF_BUSY
+//   MESSAGE_BUS_LISTENER_LATEST_ONLY
 //   MESSAGE_BUS_LISTENER_IMMEDIATE
 
 #ifndef EVENT_LISTENER_DEFAULT_FLAGS
@@ -121,6 +283,99 @@ DEALINGS IN THE SOFTWARE.
 #define MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH    10
 #endif
 
+//
+// Capacity of the MessageBus event queue, in events. The queue is allocated as part of the MessageBus, so raising
+// an event never allocates memory. Events that cannot be queued are dropped, and counted (see MessageBus::getDroppedEventCount()).
+//
+#ifndef MESSAGE_BUS_EVENT_QUEUE_SIZE
+#define MESSAGE_BUS_EVENT_QUEUE_SIZE            MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH
+#endif
+
+//
+// The number of event types (id, value pairs) that can be configured to coalesce on the MessageBus event queue
+// (see MessageBus::setCoalescing()). Costs 4 bytes of RAM per entry.
+//
+#ifndef MESSAGE_BUS_COALESCE_MAX
+#define MESSAGE_BUS_COALESCE_MAX                4
+#endif
+
+//
+// Enables an index of MessageBus listeners by event id. When enabled, an event only visits the listeners registered
+// for its id (plus any registered for DEVICE_ID_ANY), rather than every listener. The index costs a few bytes of RAM
+// per distinct event id, and is rebuilt whenever listeners are added or removed.
+// Set '1' to enable.
+//
+#ifndef MESSAGE_BUS_LISTENER_INDEX
+#define MESSAGE_BUS_LISTENER_INDEX              0
+#endif
+
+//
+// Enables pooled allocation of the objects created as listeners are registered and events are queued on them
+// (Listener, MemberFunctionCallback and EventQueueItem). Each type is allocated from its own MemoryPool, holding
+// MESSAGE_BUS_LISTENER_POOL_SIZE listeners and callbacks, and MESSAGE_BUS_EVENT_POOL_SIZE queued events. This avoids
+// heap churn when listeners are frequently added and removed. Each pool is allocated the first time it is used,
+// and overflows to the heap once full. See Listener::pool, MemberFunctionCallback::pool and EventQueueItem::pool.
+// Set '1' to enable.
+//
+#ifndef MESSAGE_BUS_LISTENER_POOL
+#define MESSAGE_BUS_LISTENER_POOL               0
+#endif
+
+#ifndef MESSAGE_BUS_LISTENER_POOL_SIZE
+#define MESSAGE_BUS_LISTENER_POOL_SIZE          16
+#endif
+
+#ifndef MESSAGE_BUS_EVENT_POOL_SIZE
+#define MESSAGE_BUS_EVENT_POOL_SIZE             16
+#endif
+
+//
+// The number of bytes an Arena draws from the heap at a time, unless otherwise specified when it is created.
+// Larger chunks mean fewer heap blocks, but more memory left unused at the end of the last chunk.
+//
+#ifndef CODAL_ARENA_CHUNK_SIZE
+#define CODAL_ARENA_CHUNK_SIZE                  256
+#endif
+
+//
+// Enables MessageBus event tracing. When enabled, the MessageBus records a histogram of the latency from the creation
+// of each event to the execution of its standard listeners, in log2 buckets of microseconds, for each of the first
+// MESSAGE_BUS_TRACE_IDS event ids seen (later ids share a final entry), and keeps the last MESSAGE_BUS_TRACE_SIZE
+// events raised, dropped, coalesced and delivered in a ring. See MessageBus::traceDump().
+// Set '1' to enable.
+//
+#ifndef MESSAGE_BUS_TRACE
+#define MESSAGE_BUS_TRACE                       0
+#endif
+
+#ifndef MESSAGE_BUS_TRACE_IDS
+#define MESSAGE_BUS_TRACE_IDS                   8
+#endif
+
+#ifndef MESSAGE_BUS_TRACE_SIZE
+#define MESSAGE_BUS_TRACE_SIZE                  32
+#endif
+
+//
+// Enables per listener dispatch statistics. When enabled, each Listener records the number of times it has been
+// invoked, the number of those invocations that blocked (and so were forked onto a fiber of their own), and the
+// cumulative time spent in the handler. See MessageBus::listenerStatisticsDump().
+// Set '1' to enable.
+//
+#ifndef MESSAGE_BUS_LISTENER_STATISTICS
+#define MESSAGE_BUS_LISTENER_STATISTICS         0
+#endif
+
+//
+// Enables adaptive dispatch of non-immediate listeners. When enabled, a listener that has been observed to block
+// is thereafter launched directly on a fiber, rather than through fork on block, saving the cost of the fork.
+// All other listeners are still called through fork on block, so a handler that blocks never holds up the event queue.
+// Set '1' to enable.
+//
+#ifndef MESSAGE_BUS_ADAPTIVE_DISPATCH
+#define MESSAGE_BUS_ADAPTIVE_DISPATCH           0
+#endif
+
 //Configures the default serial mode used by serial read and send calls.
 #ifndef DEVICE_DEFAULT_SERIAL_MODE
 #define DEVICE_DEFAULT_SERIAL_MODE            SYNC_SLEEP
@@ -53,11 +53,31 @@ DEALINGS IN THE SOFTWARE.
 
 #define DEVICE_SCHEDULER_EVT_TICK           1
 #define DEVICE_SCHEDULER_EVT_IDLE           2
+#define DEVICE_SCHEDULER_EVT_TASK           3
 
 #define DEVICE_GET_FIBER_LIST_AVAILABLE     1
 
+// Number of fiber priority levels (DEVICE_FIBER_PRIORITY)
+#define DEVICE_FIBER_PRIORITY_LEVELS        4
+
 namespace codal
 {
+    class ManagedBuffer;
+
+    /**
+      * Scheduling priority levels for fibers.
+      *
+      * If DEVICE_FIBER_PRIORITY is enabled, the scheduler always runs fibers of the highest
+      * priority level that has any runnable fibers, in round robin order within that level.
+      */
+    enum FiberPriority
+    {
+        FIBER_PRIORITY_LOW = 0,
+        FIBER_PRIORITY_NORMAL,
+        FIBER_PRIORITY_HIGH,
+        FIBER_PRIORITY_REALTIME
+    };
+
     /**
       * Representation of a single Fiber
       */
@@ -69,11 +89,32 @@ namespace codal
         uint32_t context;                   // Context specific information.
         uint32_t flags;                     // Information about this fiber.
         Fiber **queue;                      // The queue this fiber is stored on.
-        Fiber *qnext, *qprev;               // Position of this Fiber on the run queue.
+        Fiber *qnext, *qprev;               // Position of this Fiber on the run queue. If DEVICE_FIBER_QUEUE_TAIL is enabled, qprev of the head refers to the tail.
         Fiber *next;                        // Position of this Fiber on the global list of fibers.
         #if CONFIG_ENABLED(DEVICE_FIBER_USER_DATA)
         void *user_data;
         #endif
+        #if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+        uint8_t priority;                   // The FiberPriority level of this Fiber.
+        #endif
+        #if CONFIG_ENABLED(DEVICE_FIBER_WAIT_INDEX)
+        uint32_t wait_seq;                  // The order in which this Fiber started waiting on an event.
+        #endif
+        #if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS)
+        CODAL_TIMESTAMP run_time;           // Cumulative time this Fiber has been scheduled in, in microseconds.
+        uint32_t switch_count;              // Number of times this Fiber has been scheduled in.
+        uint32_t max_stack_depth;           // The deepest stack observed when this Fiber was scheduled out, in bytes.
+        #endif
+    };
+
+    /**
+      * A single entry of the scheduler trace buffer (DEVICE_FIBER_TRACE_SIZE).
+      */
+    struct FiberTraceRecord
+    {
+        CODAL_TIMESTAMP timestamp;          // Time of the context switch, as given by system_timer_current_time_us().
+        Fiber *from;                        // The fiber that was scheduled out.
+        Fiber *to;                          // The fiber that was scheduled in.
     };
 
     extern Fiber *currentFiber;
@@ -102,6 +143,46 @@ namespace codal
      */
     Fiber* get_fiber_list();
 
+#if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS)
+    /**
+     * Writes the CPU accounting information of all active fibers to DMESG.
+     *
+     * One line is written per fiber, giving its cumulative run time in microseconds, the number of
+     * times it has been scheduled in, and the deepest stack observed when it was scheduled out.
+     */
+    void fiber_statistics_dump();
+#endif
+
+#if CONFIG_ENABLED(DEVICE_FIBER_STACK_POOL)
+    /**
+     * Determines the number of fiber stack allocations served from the stack pool.
+     *
+     * @return The number of stack allocations that reused a pooled buffer.
+     */
+    uint32_t fiber_stack_pool_hits();
+
+    /**
+     * Determines the number of fiber stack allocations that could not be served from the stack pool.
+     *
+     * @return The number of stack allocations that required a heap allocation.
+     */
+    uint32_t fiber_stack_pool_misses();
+#endif
+
+#if DEVICE_FIBER_TRACE_SIZE > 0
+    /**
+     * Writes the content of the scheduler trace buffer to DMESG, oldest context switch first.
+     */
+    void fiber_trace_dump();
+
+    /**
+     * Provides a copy of the scheduler trace buffer.
+     *
+     * @return A ManagedBuffer containing an array of FiberTraceRecord, oldest context switch first.
+     */
+    ManagedBuffer fiber_trace_buffer();
+#endif
+
     /**
       * Exit point for all fibers.
       *
@@ -150,6 +231,20 @@ namespace codal
       */
     Fiber *create_fiber(void (*entry_fn)(void), void (*completion_fn)(void) = release_fiber);
 
+    /**
+      * Creates a new Fiber with the given scheduling priority, and launches it.
+      *
+      * @param entry_fn The function the new Fiber will begin execution in.
+      *
+      * @param priority The priority level of the new Fiber. Ignored unless DEVICE_FIBER_PRIORITY is enabled.
+      *
+      * @param completion_fn The function called when the thread completes execution of entry_fn.
+      *                      Defaults to release_fiber.
+      *
+      * @return The new Fiber, or NULL if the operation could not be completed.
+      */
+    Fiber *create_fiber(void (*entry_fn)(void), FiberPriority priority, void (*completion_fn)(void) = release_fiber);
+
 
     /**
       * Creates a new parameterised Fiber, and launches it.
@@ -165,6 +260,22 @@ namespace codal
       */
     Fiber *create_fiber(void (*entry_fn)(void *), void *param, void (*completion_fn)(void *) = release_fiber);
 
+    /**
+      * Creates a new parameterised Fiber with the given scheduling priority, and launches it.
+      *
+      * @param entry_fn The function the new Fiber will begin execution in.
+      *
+      * @param param an untyped parameter passed into the entry_fn and completion_fn.
+      *
+      * @param priority The priority level of the new Fiber. Ignored unless DEVICE_FIBER_PRIORITY is enabled.
+      *
+      * @param completion_fn The function called when the thread completes execution of entry_fn.
+      *                      Defaults to release_fiber.
+      *
+      * @return The new Fiber, or NULL if the operation could not be completed.
+      */
+    Fiber *create_fiber(void (*entry_fn)(void *), void *param, FiberPriority priority, void (*completion_fn)(void *) = release_fiber);
+
 
     /**
       * Calls the Fiber scheduler.
@@ -193,6 +304,8 @@ namespace codal
       * The timer callback, called from interrupt context once every SYSTEM_TICK_PERIOD_MS milliseconds.
       * This function checks to determine if any fibers blocked on the sleep queue need to be woken up
       * and made runnable.
+      *
+      * In tickless mode (SCHEDULER_TICKLESS), this is instead called once the earliest sleeping fiber is due.
       */
     void scheduler_tick(Event);
 
@@ -237,6 +350,49 @@ namespace codal
       */
     int fiber_wake_on_event(uint16_t id, uint16_t value);
 
+    /**
+      * Schedules the given function to be called in thread context, before the scheduler next goes idle.
+      *
+      * This is intended for drivers that need to move work out of interrupt context, and is lighter than
+      * raising an event for the purpose, as no listener is needed and the MessageBus is not involved.
+      * Calls are made in the order they were deferred, from a fork on block context, so may block.
+      *
+      * This function may be called from interrupt context.
+      *
+      * @param fn The function to call.
+      *
+      * @param arg The parameter to pass to fn.
+      *
+      * @param reserved If true, the call uses a slot previously reserved by fiber_defer_reserve(), rather than one of
+      *        the slots shared by all callers. A caller that never has more calls outstanding than it has reserved
+      *        slots can rely on this succeeding.
+      *
+      * @return DEVICE_OK, DEVICE_INVALID_PARAMETER if fn is NULL, or DEVICE_NO_RESOURCES if all the slots
+      *         available to the call are already in use.
+      *
+      * @code
+      * void onTransferComplete(void *p)
+      * {
+      *     ((MyDriver *)p)->complete();
+      * }
+      *
+      * // in the interrupt handler...
+      * fiber_defer(onTransferComplete, this);
+      * @endcode
+      */
+    int fiber_defer(void (*fn)(void *), void *arg, bool reserved = false);
+
+    /**
+      * Permanently reserves a slot on the deferred call queue, for use by calls to fiber_defer() with reserved set.
+      *
+      * A driver that defers a single completion at a time (e.g. the end of a transfer) can reserve a slot when it
+      * is created, so that the completion is never lost, however busy the queue is. Each reservation reduces the
+      * number of slots shared by other callers by one.
+      *
+      * @return DEVICE_OK, or DEVICE_NO_RESOURCES if every slot is already reserved, or in use by calls without a reservation.
+      */
+    int fiber_defer_reserve();
+
     /**
       * Executes the given function asynchronously if necessary.
       *
@@ -291,6 +447,14 @@ namespace codal
       */
     void scheduler_event(Event evt);
 
+    /**
+      * Registers a function to be offered each NOTIFY_ONE event that no fiber is waiting on. This keeps the
+      * decision of which single waiter is notified in one place: fibers are always notified first.
+      *
+      * @param handler The function to call with the event, or NULL to remove any handler registered.
+      */
+    void scheduler_set_notify_one_handler(void (*handler)(Event evt));
+
     /**
       * Determines if any fibers are waiting to be scheduled.
       *
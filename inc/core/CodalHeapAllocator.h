@@ -44,7 +44,8 @@ DEALINGS IN THE SOFTWARE.
   * @note The need for this should be reviewed in the future, if a different memory allocator is
   * made available in the mbed platform.
   *
-  * TODO: Consider caching recently freed blocks to improve allocation time.
+  * Recently freed blocks may also be cached by size class to improve allocation time (see DEVICE_HEAP_CACHE),
+  * and the first fit walk may be replaced by segregated free lists (see DEVICE_HEAP_SEGREGATED).
   */
 
 #ifndef DEVICE_HEAP_ALLOCTOR_H
@@ -53,13 +54,57 @@ DEALINGS IN THE SOFTWARE.
 #include "CodalConfig.h"
 
 // Flag to indicate that a given block is FREE/USED (top bit of a CPU word)
-#define DEVICE_HEAP_BLOCK_FREE		(1 << (sizeof(PROCESSOR_WORD_TYPE) * 8 - 1))
+#define DEVICE_HEAP_BLOCK_FREE		((PROCESSOR_WORD_TYPE)1 << (sizeof(PROCESSOR_WORD_TYPE) * 8 - 1))
 #define DEVICE_HEAP_BLOCK_SIZE      (sizeof(PROCESSOR_WORD_TYPE))
 
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+// Flag to indicate that the block before a given block is FREE (next to top bit of a CPU word)
+#define DEVICE_HEAP_BLOCK_PREV_FREE ((PROCESSOR_WORD_TYPE)1 << (sizeof(PROCESSOR_WORD_TYPE) * 8 - 2))
+#else
+#define DEVICE_HEAP_BLOCK_PREV_FREE 0
+#endif
+
+// The flags held in the index block, alongside the size of the block.
+#define DEVICE_HEAP_BLOCK_FLAGS     (DEVICE_HEAP_BLOCK_FREE | DEVICE_HEAP_BLOCK_PREV_FREE)
+
+// The number of size classes allocations are counted in. Class n holds allocations of up to (16 << n) bytes,
+// with the last class holding all larger allocations.
+#define DEVICE_HEAP_SIZE_CLASSES    8
+
 struct HeapDefinition
 {
     PROCESSOR_WORD_TYPE *heap_start;		// Physical address of the start of this heap.
     PROCESSOR_WORD_TYPE *heap_end;		    // Physical address of the end of this heap.
+    PROCESSOR_WORD_TYPE used;               // The number of blocks currently allocated, including index blocks.
+    PROCESSOR_WORD_TYPE peak;               // The highest value used has reached.
+    uint32_t failed;                        // The number of allocations this heap could not satisfy.
+    uint32_t allocations[DEVICE_HEAP_SIZE_CLASSES];  // The number of allocations made in each size class.
+#if CONFIG_ENABLED(DEVICE_HEAP_CACHE)
+    PROCESSOR_WORD_TYPE *cache[DEVICE_HEAP_CACHE_CLASSES];  // Stacks of freed blocks held for reuse, by size class.
+    uint8_t cached[DEVICE_HEAP_CACHE_CLASSES];              // The number of blocks on each stack.
+#endif
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+    PROCESSOR_WORD_TYPE *bins[DEVICE_HEAP_SEGREGATED_CLASSES];  // Lists of free blocks, by power of two size class.
+    PROCESSOR_WORD_TYPE *tree;                                  // The root of a tree of the larger free blocks, ordered by size.
+#endif
+};
+
+/**
+  * A snapshot of the state of a heap, as reported by device_heap_stats().
+  * All sizes are in bytes, and include the index block the allocator keeps with each allocation.
+  */
+struct HeapStats
+{
+    uint32_t totalBytes;                    // The total size of the heap.
+    uint32_t usedBytes;                     // The memory currently allocated.
+    uint32_t freeBytes;                     // The memory currently available, including cachedBytes.
+    uint32_t cachedBytes;                   // The memory held in the size class caches, if DEVICE_HEAP_CACHE is enabled.
+    uint32_t largestFreeBytes;              // The largest contiguous free region, which bounds the largest possible allocation.
+    uint32_t peakBytes;                     // The most memory that has been allocated at any one time.
+    uint16_t usedBlocks;                    // The number of allocations currently live.
+    uint16_t freeBlocks;                    // The number of separate free regions. Large numbers of these indicate fragmentation.
+    uint32_t failed;                        // The number of allocations the heap could not satisfy.
+    uint32_t allocations[DEVICE_HEAP_SIZE_CLASSES];  // The number of allocations made in each size class (see DEVICE_HEAP_SIZE_CLASSES).
 };
 extern PROCESSOR_WORD_TYPE codal_heap_start;
 
@@ -90,6 +135,21 @@ int device_create_heap(PROCESSOR_WORD_TYPE start, PROCESSOR_WORD_TYPE end);
  */
 uint32_t device_heap_size(uint8_t heap_index);
 
+/**
+ * Reports the usage and fragmentation of a given heap.
+ *
+ * The allocation counters are maintained as memory is allocated and freed, but the free space figures
+ * require a walk of the heap, with interrupts disabled. That walk is no longer than a single allocation
+ * from a fragmented heap, so this is cheap enough to poll periodically.
+ *
+ * @param heap_index index between 0 and DEVICE_MAXIMUM_HEAPS-1
+ *
+ * @param stats The structure to fill in.
+ *
+ * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if no such heap exists or stats is NULL.
+ */
+int device_heap_stats(uint8_t heap_index, HeapStats *stats);
+
 
 /**
   * Attempt to allocate a given amount of memory from any of our configured heap areas.
@@ -108,11 +168,21 @@ extern "C" void* device_malloc(size_t size);
 extern "C" void device_free(void *mem);
 
 /**
-  * Copy existing contents of ptr to a new memory block of given size.
+  * Resize the memory block at ptr to the given size. The block is resized in place if it is shrinking,
+  * or if it is directly followed by enough free memory. Otherwise, its contents are copied to a new
+  * memory block of the given size, and the old block is released.
   *
   * @param ptr The existing memory block (can be NULL)
   * @param size The size of new block (can be smaller or larger than the old one)
   */
 extern "C" void* device_realloc(void* ptr, size_t size);
 
+/**
+  * Reports how many calls to device_realloc() resized a block in place, and how many had to move it.
+  *
+  * @param inPlace Set to the number of reallocations satisfied without moving the block. May be NULL.
+  * @param moved Set to the number of reallocations that copied the block to a new allocation. May be NULL.
+  */
+void device_realloc_stats(uint32_t *inPlace, uint32_t *moved);
+
 #endif
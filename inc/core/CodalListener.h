@@ -28,6 +28,7 @@ DEALINGS IN THE SOFTWARE.
 #include "CodalConfig.h"
 #include "Event.h"
 #include "MemberFunctionCallback.h"
+#include "CodalPool.h"
 
 // Listener flags...
 #define MESSAGE_BUS_LISTENER_PARAMETERISED          0x0001
@@ -38,6 +39,9 @@ DEALINGS IN THE SOFTWARE.
 #define MESSAGE_BUS_LISTENER_DROP_IF_BUSY           0x0020
 #define MESSAGE_BUS_LISTENER_NONBLOCKING            0x0040
 #define MESSAGE_BUS_LISTENER_URGENT                 0x0080
+#define MESSAGE_BUS_LISTENER_HAS_BLOCKED            0x0100
+#define MESSAGE_BUS_LISTENER_LATEST_ONLY            0x0200
+#define MESSAGE_BUS_LISTENER_BATCH                  0x0400
 #define MESSAGE_BUS_LISTENER_DELETING               0x8000
 
 #define MESSAGE_BUS_LISTENER_IMMEDIATE              (MESSAGE_BUS_LISTENER_NONBLOCKING |  MESSAGE_BUS_LISTENER_URGENT)
@@ -59,6 +63,7 @@ namespace codal
         {
             void (*cb)(Event);
             void (*cb_param)(Event, void *);
+            void (*cb_batch)(const Event *, int);
             MemberFunctionCallback *cb_method;
         };
 
@@ -69,6 +74,12 @@ namespace codal
 
         Listener *next;
 
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_STATISTICS)
+        uint32_t        invocations;    // Number of times the handler has been invoked.
+        uint32_t        blocks;         // Number of invocations that blocked, and so were forked onto a fiber of their own.
+        CODAL_TIMESTAMP run_time;       // Cumulative time spent in the handler in microseconds, including any time spent blocked.
+#endif
+
         /**
           * Constructor.
           *
@@ -124,6 +135,22 @@ namespace codal
         template <typename T>
         Listener(uint16_t id, uint16_t value, T* object, void (T::*method)(Event), uint16_t flags = EVENT_LISTENER_DEFAULT_FLAGS);
 
+        /**
+          * Constructor.
+          *
+          * Create a new Message Bus Listener, with a callback that receives events in batches.
+          *
+          * @param id The ID of the component you want to listen to.
+          *
+          * @param value The event value you would like to listen to from that component
+          *
+          * @param handler A function pointer to call with the matching events, and the number of them.
+          *
+          * @param flags User specified, implementation specific flags, that allow behaviour of this events listener
+          * to be tuned.
+          */
+        Listener(uint16_t id, uint16_t value, void (*handler)(const Event *, int), uint16_t flags = EVENT_LISTENER_DEFAULT_FLAGS);
+
         /**
           * Destructor. Ensures all resources used by this listener are freed.
           */
@@ -135,6 +162,25 @@ namespace codal
           * @param e The event to queue
           */
         void queue(Event e);
+
+        /**
+          * Resets the dispatch statistics of this listener.
+          */
+        void resetStatistics();
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_POOL)
+        static MemoryPool pool;         // The pool Listeners are allocated from.
+
+        /**
+          * Allocates memory for a new instance from the pool.
+          */
+        static void *operator new(size_t size);
+
+        /**
+          * Returns the memory of an instance to the pool.
+          */
+        static void operator delete(void *p);
+#endif
     };
 
     /**
@@ -163,6 +209,7 @@ namespace codal
         this->flags = flags | MESSAGE_BUS_LISTENER_METHOD;
         this->evt_queue = NULL;
         this->next = NULL;
+        resetStatistics();
     }
 }
 
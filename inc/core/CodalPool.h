@@ -0,0 +1,121 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef CODAL_POOL_H
+#define CODAL_POOL_H
+
+#include "CodalConfig.h"
+
+namespace codal
+{
+    /**
+      * A pool of fixed size memory blocks.
+      *
+      * The blocks are carved from a single arena, allocated from the heap the first time a block is requested,
+      * and are recycled through a free list. This avoids heap churn and fragmentation for small objects that
+      * are frequently created and destroyed. Once the arena is exhausted, further blocks are allocated from
+      * the heap as usual, and are freed back to it when released.
+      *
+      * A pool is normally used through class specific operator new and operator delete.
+      *
+      * @code
+      * static MemoryPool pool(sizeof(Listener), 16);
+      *
+      * void *Listener::operator new(size_t size)
+      * {
+      *     return pool.allocate(size);
+      * }
+      *
+      * void Listener::operator delete(void *p)
+      * {
+      *     pool.release(p);
+      * }
+      * @endcode
+      */
+    class MemoryPool
+    {
+        uint8_t     *arena;         // The memory the blocks are carved from, or NULL if not yet allocated.
+        void        *freeList;      // Chain of free blocks within the arena.
+        uint16_t    blockSize;      // The size of each block, in bytes.
+        uint16_t    blockCount;     // The number of blocks in the arena.
+        uint16_t    used;           // The number of blocks of the arena currently allocated.
+        uint16_t    peak;           // The largest number of blocks of the arena that have been allocated at once.
+        uint32_t    overflows;      // The number of allocations made from the heap as the arena was full.
+
+        public:
+
+        /**
+          * Constructor. Creates a pool. No memory is allocated until the first block is requested.
+          *
+          * @param blockSize The size of each block, in bytes.
+          *
+          * @param blockCount The number of blocks in the arena.
+          */
+        MemoryPool(size_t blockSize, uint16_t blockCount);
+
+        /**
+          * Allocates a block from the pool, or from the heap if the pool is exhausted or the size requested
+          * is larger than the blocks of the pool.
+          *
+          * @param size The number of bytes required.
+          *
+          * @return A pointer to the memory allocated, or NULL if there is insufficient memory.
+          */
+        void *allocate(size_t size);
+
+        /**
+          * Releases a block previously returned by allocate().
+          *
+          * @param block The block to release. May be NULL.
+          */
+        void release(void *block);
+
+        /**
+          * Determines if a block was allocated from the arena of this pool, rather than from the heap.
+          *
+          * @param block The block to inspect.
+          *
+          * @return true if the block lies within the arena of this pool, false otherwise.
+          */
+        bool contains(void *block);
+
+        /**
+          * Determines the number of blocks of the arena currently allocated.
+          */
+        int getUsed();
+
+        /**
+          * Determines the largest number of blocks of the arena that have been allocated at once.
+          */
+        int getPeak();
+
+        /**
+          * Determines the number of allocations that were made from the heap as the arena was full.
+          */
+        uint32_t getOverflowCount();
+    };
+}
+
+#endif
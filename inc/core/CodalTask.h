@@ -0,0 +1,209 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Lightweight, stackless tasks.
+  *
+  * A Task is a protothread: a function that can block on sleeps and events like a Fiber, but that
+  * returns to its caller whenever it does so, and is later re-entered at the point it blocked.
+  * Tasks therefore own no stack and no thread context. All tasks are run, one at a time, by a single
+  * fiber created the first time a task is started, so a pending task costs only the Task structure itself,
+  * plus any state it derives (see below). A Task is 16 bytes on a 32 bit target (24 bytes on a 64 bit host),
+  * so a thousand pending tasks use 16KB. The runner fiber is created once, and costs the same as any other fiber.
+  *
+  * Tasks may wait on the NOTIFY channel alongside fibers. A NOTIFY_ONE event wakes a single waiter: the
+  * longest waiting fiber if there is one, otherwise the longest waiting task.
+  *
+  * Because a task function returns whenever it blocks, its local variables are lost at that point.
+  * State that must persist across a blocking operation should be held in a structure derived from Task.
+  * Blocking operations may only be used from the body of the task function itself, and not from
+  * within switch statements or functions it calls. At most one may be used on each line of source.
+  *
+  * @code
+  * struct Blinker : Task
+  * {
+  *     int count;
+  * };
+  *
+  * int blink(Task *t)
+  * {
+  *     Blinker *b = (Blinker *)t;
+  *
+  *     TASK_BEGIN(t);
+  *
+  *     for (b->count = 0; b->count < 10; b->count++)
+  *     {
+  *         led.setDigitalValue(b->count & 1);
+  *         TASK_SLEEP(t, 500);
+  *     }
+  *
+  *     TASK_WAIT_FOR_EVENT(t, DEVICE_ID_BUTTON_A, DEVICE_BUTTON_EVT_CLICK);
+  *
+  *     TASK_END(t);
+  * }
+  *
+  * static Blinker blinker;
+  * task_start(&blinker, blink);
+  * @endcode
+  */
+#ifndef CODAL_TASK_H
+#define CODAL_TASK_H
+
+#include "CodalConfig.h"
+#include "ErrorNo.h"
+#include "Event.h"
+
+// Task states
+#define DEVICE_TASK_STATE_IDLE              0
+#define DEVICE_TASK_STATE_READY             1
+#define DEVICE_TASK_STATE_SLEEPING          2
+#define DEVICE_TASK_STATE_WAITING           3
+
+// Values returned by a task function, indicating what the task runner should do with the task.
+#define DEVICE_TASK_EXITED                  0
+#define DEVICE_TASK_YIELDED                 1
+#define DEVICE_TASK_BLOCKED                 2
+
+// Marks the deliberate fall through into the case label of a blocking call, so that code using the
+// macros below builds cleanly with -Wimplicit-fallthrough.
+#if defined(__has_attribute)
+#if __has_attribute(fallthrough)
+#define DEVICE_TASK_FALLTHROUGH             __attribute__((fallthrough))
+#endif
+#endif
+
+#ifndef DEVICE_TASK_FALLTHROUGH
+#define DEVICE_TASK_FALLTHROUGH
+#endif
+
+/**
+  * Marks the start of the body of a task function.
+  */
+#define TASK_BEGIN(t)                       switch ((t)->lc) { case 0:
+
+/**
+  * Marks the end of the body of a task function. The task exits once it reaches this point.
+  */
+#define TASK_END(t)                         } (t)->lc = 0; return DEVICE_TASK_EXITED;
+
+/**
+  * Exits the task immediately.
+  */
+#define TASK_EXIT(t)                        do { (t)->lc = 0; return DEVICE_TASK_EXITED; } while (0)
+
+/**
+  * Gives other tasks the opportunity to run. The task remains runnable.
+  */
+#define TASK_YIELD(t)                       do { (t)->lc = __LINE__; return DEVICE_TASK_YIELDED; case __LINE__:; } while (0)
+
+/**
+  * Yields repeatedly until the given condition holds.
+  */
+#define TASK_WAIT_UNTIL(t, condition)       do { (t)->lc = __LINE__; case __LINE__: if (!(condition)) return DEVICE_TASK_YIELDED; } while (0)
+
+/**
+  * Blocks the task for the given period of time, in milliseconds. See task_sleep().
+  */
+#define TASK_SLEEP(t, ms)                   do { (t)->lc = __LINE__; if (codal::task_sleep((t), (ms)) == DEVICE_OK) return DEVICE_TASK_BLOCKED; DEVICE_TASK_FALLTHROUGH; case __LINE__:; } while (0)
+
+/**
+  * Blocks the task until the given event is raised. See task_wait_for_event().
+  */
+#define TASK_WAIT_FOR_EVENT(t, id, value)   do { (t)->lc = __LINE__; if (codal::task_wait_for_event((t), (id), (value)) == DEVICE_OK) return DEVICE_TASK_BLOCKED; DEVICE_TASK_FALLTHROUGH; case __LINE__:; } while (0)
+
+namespace codal
+{
+    /**
+      * Representation of a single Task.
+      */
+    struct Task
+    {
+        Task *next;                         // Position of this Task on the queue it is stored on.
+        int (*fn)(Task *);                  // The task function.
+        uint32_t context;                   // Wake up time, or the event this task is blocked on.
+        uint16_t lc;                        // The point from which the task function resumes.
+        uint8_t state;                      // The DEVICE_TASK_STATE of this task.
+
+        /**
+          * Constructor. Creates an idle task.
+          */
+        Task() : next(NULL), fn(NULL), context(0), lc(0), state(DEVICE_TASK_STATE_IDLE) {}
+    };
+
+    /**
+      * Starts the given task. The task function is called from the task runner fiber, starting from TASK_BEGIN.
+      *
+      * @param t The task to start. The task must remain valid until it exits, or is stopped.
+      *
+      * @param fn The task function.
+      *
+      * @return DEVICE_OK, DEVICE_INVALID_PARAMETER if a parameter is NULL, DEVICE_BUSY if the task is already running,
+      *         DEVICE_NOT_SUPPORTED if the fiber scheduler is not running, or DEVICE_NO_RESOURCES if the task runner could not be created.
+      */
+    int task_start(Task *t, int (*fn)(Task *));
+
+    /**
+      * Stops the given task, without running it any further. The task may then be started again.
+      *
+      * @param t The task to stop.
+      *
+      * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if t is NULL.
+      */
+    int task_stop(Task *t);
+
+    /**
+      * Determines if the given task has been started, and has not yet exited.
+      *
+      * @param t The task to inspect.
+      *
+      * @return 1 if the task is running, 0 otherwise.
+      */
+    int task_running(Task *t);
+
+    /**
+      * Configures the given task to sleep for the given period of time. Normally used through TASK_SLEEP().
+      *
+      * @param t The task to configure. This must be the task currently being run.
+      *
+      * @param ms The period of time to sleep, in milliseconds.
+      *
+      * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if t is not being run.
+      */
+    int task_sleep(Task *t, unsigned long ms);
+
+    /**
+      * Configures the given task to block until the specified event is raised. Normally used through TASK_WAIT_FOR_EVENT().
+      *
+      * @param t The task to configure. This must be the task currently being run.
+      *
+      * @param id The ID field of the event to listen for (e.g. DEVICE_ID_BUTTON_A)
+      *
+      * @param value The value of the event to listen for (e.g. DEVICE_BUTTON_EVT_CLICK)
+      *
+      * @return DEVICE_OK, DEVICE_INVALID_PARAMETER if t is not being run, or DEVICE_NOT_SUPPORTED if there is no EventModel.
+      */
+    int task_wait_for_event(Task *t, uint16_t id, uint16_t value);
+}
+
+#endif
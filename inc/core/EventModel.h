@@ -101,6 +101,37 @@ namespace codal
             return DEVICE_NOT_SUPPORTED;
         }
 
+        /**
+          * Queues the given events to be sent to all registered recipients.
+          * The method of delivery will vary depending on the underlying implementation.
+          *
+          * @param events The events to send.
+          *
+          * @param count The number of events to send.
+          *
+          * @return This default implementation simply returns DEVICE_NOT_SUPPORTED.
+          */
+        virtual int sendBatch(const Event *, int)
+        {
+            return DEVICE_NOT_SUPPORTED;
+        }
+
+        /**
+          * Configures whether events of the given type are coalesced whilst they wait to be processed.
+          *
+          * @param id The source of the events.
+          *
+          * @param value The value of the events, or DEVICE_EVT_ANY for all events from the given source.
+          *
+          * @param enable true to coalesce the events, false to queue each one.
+          *
+          * @return This default implementation simply returns DEVICE_NOT_SUPPORTED.
+          */
+        virtual int setCoalescing(uint16_t, uint16_t, bool)
+        {
+            return DEVICE_NOT_SUPPORTED;
+        }
+
         /**
           * Returns the Listener at the given position in the list.
           *
@@ -244,6 +275,55 @@ namespace codal
             return DEVICE_NOT_SUPPORTED;
         }
 
+        /**
+          * Register a listener function that receives events in batches.
+          *
+          * The handler is called with all of the matching events of a batch raised through sendBatch(),
+          * in the order they were raised, or with a single event raised through send(). The events
+          * are only valid until the handler returns.
+          *
+          * @param id The source of messages to listen for. Events sent from any other IDs will be filtered.
+          * Use DEVICE_ID_ANY to receive events from all components.
+          *
+          * @param value The value of messages to listen for. Events with any other values will be filtered.
+          * Use DEVICE_EVT_ANY to receive events of any value.
+          *
+          * @param handler The function to call with the events received, and the number of them.
+          *
+          * @param flags User specified, implementation specific flags, that allow behaviour of this events listener
+          * to be tuned.
+          *
+          * @return DEVICE_OK on success, or any valid error code defined in "ErrNo.h". The default implementation
+          * simply returns DEVICE_NOT_SUPPORTED.
+          *
+          * @code
+          * void onEdges(const Event *events, int count)
+          * {
+          *     for (int i = 0; i < count; i++)
+          *         //do something with events[i]
+          * }
+          *
+          * uBit.messageBus.listen(DEVICE_ID_IO_P0, DEVICE_PIN_EVT_RISE, onEdges);
+          * @endcode
+          */
+        int listen(int id, int value, void (*handler)(const Event *, int), uint16_t flags = EVENT_LISTENER_DEFAULT_FLAGS)
+        {
+            if (handler == NULL)
+                return DEVICE_INVALID_PARAMETER;
+
+            if(id == DEVICE_ID_SCHEDULER && flags != MESSAGE_BUS_LISTENER_IMMEDIATE)
+                return DEVICE_INVALID_PARAMETER;
+
+            Listener *newListener = new Listener(id, value, handler, flags);
+
+            if(add(newListener) == DEVICE_OK)
+                return DEVICE_OK;
+
+            delete newListener;
+
+            return DEVICE_NOT_SUPPORTED;
+        }
+
         /**
           * Register a listener function.
           *
@@ -448,6 +528,28 @@ namespace codal
             return DEVICE_OK;
         }
 
+        /**
+          * Unregister a batch listener function.
+          * Listeners are identified by the Event ID, Event value and handler registered using listen().
+          *
+          * @param id The Event ID used to register the listener.
+          * @param value The Event value used to register the listener.
+          * @param handler The function used to register the listener.
+          *
+          * @return DEVICE_OK on success or DEVICE_INVALID_PARAMETER if the handler
+          *         given is NULL.
+          */
+        int ignore(int id, int value, void (*handler)(const Event *, int))
+        {
+            if (handler == NULL)
+                return DEVICE_INVALID_PARAMETER;
+
+            Listener listener(id, value, handler);
+            remove(&listener);
+
+            return DEVICE_OK;
+        }
+
         /**
           * Unregister a listener function.
           * Listners are identified by the Event ID, Event value and handler registered using listen().
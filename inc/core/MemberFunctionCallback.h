@@ -28,6 +28,7 @@ DEALINGS IN THE SOFTWARE.
 #include "CodalConfig.h"
 #include "Event.h"
 #include "CodalCompat.h"
+#include "CodalPool.h"
 
 /**
   * Class definition for a MemberFunctionCallback.
@@ -67,6 +68,20 @@ namespace codal
           */
         bool operator==(const MemberFunctionCallback &mfc);
 
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_POOL)
+        static MemoryPool pool;         // The pool MemberFunctionCallbacks are allocated from.
+
+        /**
+          * Allocates memory for a new instance from the pool.
+          */
+        static void *operator new(size_t size);
+
+        /**
+          * Returns the memory of an instance to the pool.
+          */
+        static void operator delete(void *p);
+#endif
+
         /**
           * Calls the method reference held by this MemberFunctionCallback.
           *
@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "Pin.h"
 #include "CoordinateSystem.h"
 #include "CodalUtil.h"
+#include "CodalChannel.h"
 
 /**
   * Status flags
@@ -119,6 +120,7 @@ namespace codal
         uint16_t        lastGesture;        // the last, stable gesture recorded.
         uint16_t        currentGesture;     // the instantaneous, unfiltered gesture detected.
         ShakeHistory    shake;              // State information needed to detect shake events.
+        Channel<Sample3D> *sampleChannel;   // An optional channel on which each sample is published.
 
         public:
 
@@ -213,6 +215,15 @@ namespace codal
          */
         virtual int update();
 
+        /**
+          * Configures a channel on which each new sample is published, in the coordinate system defined in the constructor.
+          * Subscribers to the channel receive every sample, rather than reading the latest through getSample()
+          * when notified by ACCELEROMETER_EVT_DATA_UPDATE. Samples are dropped whilst the pool of the channel is exhausted.
+          *
+          * @param channel The channel to publish samples on, or NULL to stop publishing.
+          */
+        void setSampleChannel(Channel<Sample3D> *channel);
+
         /**
           * Reads the last accelerometer value stored, and provides it in the coordinate system requested.
           *
@@ -29,6 +29,8 @@ DEALINGS IN THE SOFTWARE.
 #include "ErrorNo.h"
 #include "LowLevelTimer.h"
 
+// The number of events the event list of a Timer can hold initially. Once three quarters full, the list is doubled
+// in thread context. Events cannot be set whilst it is completely full, so this should cover any bursts.
 #ifndef CODAL_TIMER_DEFAULT_EVENT_LIST_SIZE
 #define CODAL_TIMER_DEFAULT_EVENT_LIST_SIZE     10
 #endif
@@ -53,8 +55,8 @@ namespace codal
 
     class Timer
     {
-        uint16_t sigma;
-        uint16_t delta;
+        uint32_t sigma;
+        uint32_t delta;
         LowLevelTimer& timer;
 
         /**
@@ -62,18 +64,57 @@ namespace codal
           */
         void sync();
 
+        /**
+         * Determines the range of the underlying counter, assuming at least a 16 bit counter.
+         *
+         * @return a mask of the bits of the counter that sync() can rely on.
+         */
+        uint32_t counterMask();
+
         /**
          * request to the physical timer implementation code to provide a trigger callback at the given time.
          * @note it is perfectly legitimate for the implementation to trigger before this time if convenient.
+         *       Requests are limited to half the counter period, so the counter is never allowed to wrap unseen.
          * @param t Indication that t time units (typically microsends) have elapsed.
          */
         void triggerIn(CODAL_TIMESTAMP t);
 
         /**
-         * Make sure nextTimerEvent is pointing the the right event.
+         * Schedule the low level timer for the earliest pending event, if any.
          */
         void recomputeNextTimerEvent();
 
+        /**
+         * Moves the event at the given position of the heap towards the root, until it is no earlier than its parent.
+         *
+         * @param i The index of the event in timerEventList.
+         *
+         * @return The new index of the event.
+         */
+        int siftUp(int i);
+
+        /**
+         * Moves the event at the given position of the heap towards the leaves, until it is no later than its children.
+         *
+         * @param i The index of the event in timerEventList.
+         */
+        void siftDown(int i);
+
+        /**
+         * Removes the event at the given position of the heap.
+         *
+         * @param i The index of the event in timerEventList.
+         */
+        void removeTimerEvent(int i);
+
+        /**
+         * Doubles the number of events the event list can hold.
+         * This allocates memory, so is deferred to thread context by setEvent(), which may be called from an interrupt.
+         *
+         * @param t The Timer whose event list should be grown.
+         */
+        static void growEventList(void *t);
+
     public:
 
         uint8_t ccPeriodChannel;
@@ -188,12 +229,11 @@ namespace codal
         CODAL_TIMESTAMP currentTimeUs;
         uint32_t overflow;
 
-        TimerEvent *timerEventList;
-        TimerEvent *nextTimerEvent;
-        int eventListSize;
+        TimerEvent *timerEventList;         // The pending events, held as a binary min-heap ordered by timestamp.
+        int eventListSize;                  // The number of events timerEventList can hold.
+        int eventCount;                     // The number of pending events.
+        bool growPending;                   // true if growEventList() has been deferred, but has not yet run.
 
-        TimerEvent *getTimerEvent();
-        void releaseTimerEvent(TimerEvent *event);
         int setEvent(CODAL_TIMESTAMP period, uint16_t id, uint16_t value, bool repeat);
     };
 
@@ -289,8 +329,13 @@ namespace codal
      * @return DEVICE_OK
      *
      * @note the amount of cycles per iteration will vary between CPUs.
+     * @note this is a weak symbol, so a target may provide its own implementation.
      */
+#if defined(__arm__)
     __attribute__((noinline, long_call, section(".data")))
+#else
+    __attribute__((noinline))
+#endif
     void system_timer_wait_cycles(uint32_t cycles);
 
     /**
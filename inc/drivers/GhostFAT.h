@@ -26,6 +26,7 @@ DEALINGS IN THE SOFTWARE.
 #define DEVICE_GHOSTFAT_H
 
 #include "USBMSC.h"
+#include "CodalArena.h"
 
 #if CONFIG_ENABLED(DEVICE_USB)
 
@@ -58,6 +59,7 @@ class GhostFAT : public USBMSC
 
 protected:
     GFATEntry *files;
+    Arena entries;          // The memory the entries of files are allocated from. They live as long as the GhostFAT.
     void finalizeFiles();
 
 public:
@@ -31,9 +31,64 @@ DEALINGS IN THE SOFTWARE.
 #include "CodalListener.h"
 #include "EventModel.h"
 
+// States of the entries of the MessageBus event queue.
+#define MESSAGE_BUS_QUEUE_SLOT_RESERVED     0
+#define MESSAGE_BUS_QUEUE_SLOT_READY        1
+#define MESSAGE_BUS_QUEUE_SLOT_CANCELLED    2
+#define MESSAGE_BUS_QUEUE_SLOT_BATCHED      3       // Ready, and followed by further events of the same sendBatch() call.
+
+// Types of MessageBus trace records (MESSAGE_BUS_TRACE).
+#define MESSAGE_BUS_TRACE_RAISED            1
+#define MESSAGE_BUS_TRACE_DROPPED           2
+#define MESSAGE_BUS_TRACE_COALESCED         3
+#define MESSAGE_BUS_TRACE_DELIVERED         4
+
+// The number of log2 buckets in each MessageBus latency histogram. The last bucket holds all latencies of 2^14 us or more.
+#define MESSAGE_BUS_LATENCY_BUCKETS         16
 
 namespace codal
 {
+    /**
+      * A batch of events raised through MessageBus::sendBatch(), as taken from the event queue.
+      */
+    struct EventBatch
+    {
+        Listener        *listener;      // The batch listener these events are to be delivered to, or NULL for a batch raised through sendBatch().
+        int             count;          // The number of events in the batch.
+        Event           events[1];      // The events, in the order they were raised. Allocated to hold count events.
+    };
+
+    /**
+      * An entry of the MessageBus listener index (MESSAGE_BUS_LISTENER_INDEX).
+      */
+    struct ListenerIndexEntry
+    {
+        uint16_t        id;             // The event id.
+        Listener        *first;         // The first listener on the list of listeners with this id.
+    };
+
+#if CONFIG_ENABLED(MESSAGE_BUS_TRACE)
+    /**
+      * A record of the MessageBus trace ring (MESSAGE_BUS_TRACE).
+      */
+    struct MessageBusTraceRecord
+    {
+        uint32_t        time;           // The time of the record, in microseconds since power on (modulo 2^32).
+        uint16_t        id;             // The source of the event.
+        uint16_t        value;          // The value of the event.
+        uint32_t        info;           // The MESSAGE_BUS_TRACE type in the upper 8 bits. For delivered events, the latency in microseconds in the lower 24 bits.
+    };
+
+    /**
+      * The latency histogram of one event id (MESSAGE_BUS_TRACE).
+      */
+    struct MessageBusLatencyHistogram
+    {
+        uint16_t        id;                                     // The event id, or DEVICE_ID_ANY for the entry shared by ids without one of their own.
+        uint16_t        buckets[MESSAGE_BUS_LATENCY_BUCKETS];   // The number of deliveries with a latency of [2^(n-1), 2^n) us (0 us for n = 0), saturating at 65535.
+    };
+#endif
+
     /**
       * Class definition for the MessageBus.
       *
@@ -94,6 +149,32 @@ namespace codal
           */
         virtual int send(Event evt);
 
+        /**
+          * Queues the given events to be sent to all registered recipients, as a batch.
+          *
+          * Urgent listeners receive each event immediately, as with send(). The events are then held on the
+          * event queue, in order with those raised through send(), and processed in a single pass over the
+          * listeners once they reach the front of the queue. Listeners registered with a batch handler receive
+          * all of their matching events in one call, and other listeners receive each matching event in turn.
+          * This function allocates no memory, so may be called from interrupt context.
+          *
+          * @param events The events to send. These are copied, so need not remain valid after this call.
+          *
+          * @param count The number of events to send.
+          *
+          * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if events is NULL or count is not positive,
+          *         or DEVICE_NO_RESOURCES if the event queue cannot hold the whole batch, in which case any events
+          *         not taken by urgent listeners are dropped.
+          *
+          * @code
+          * Event edges[4];
+          * int n = captureEdges(edges, 4);
+          *
+          * bus.sendBatch(edges, n);
+          * @endcode
+          */
+        virtual int sendBatch(const Event *events, int count);
+
         /**
           * Internal function, used to deliver the given event to all relevant recipients.
           * Normally, this is called once an event has been removed from the event queue.
@@ -142,15 +223,87 @@ namespace codal
           */
         virtual int remove(Listener *newListener);
 
+        /**
+          * Configures whether events of the given type are coalesced whilst they wait to be processed.
+          *
+          * A coalesced event that is raised whilst an identical event (same id and value) is already waiting
+          * on the event queue is not queued again. Instead, the timestamp of the waiting event is updated,
+          * so that listeners see one event, carrying the time of the most recent. Listeners registered as
+          * MESSAGE_BUS_LISTENER_URGENT still receive every event.
+          *
+          * This is useful to bound the queue depth and processing time of high rate sources,
+          * such as periodic sensor updates, whose listeners only need the latest state.
+          *
+          * @param id The source of the events.
+          *
+          * @param value The value of the events, or DEVICE_EVT_ANY for all events from the given source.
+          *
+          * @param enable true to coalesce the events, false to queue each one.
+          *
+          * @return DEVICE_OK on success, or DEVICE_NO_RESOURCES if MESSAGE_BUS_COALESCE_MAX event types are already coalesced.
+          */
+        virtual int setCoalescing(uint16_t id, uint16_t value, bool enable);
+
+        /**
+          * Determines the number of events dropped as the event queue was full.
+          *
+          * @return The number of events dropped since the MessageBus was created.
+          */
+        uint32_t getDroppedEventCount();
+
+        /**
+          * Determines the number of events merged into an identical waiting event, rather than being queued (see setCoalescing()).
+          *
+          * @return The number of events coalesced since the MessageBus was created.
+          */
+        uint32_t getCoalescedEventCount();
+
+        /**
+          * Determines the largest number of events that have been held in the event queue at once.
+          *
+          * @return The peak length of the event queue, up to MESSAGE_BUS_EVENT_QUEUE_SIZE.
+          */
+        int getPeakQueueLength();
+
+#if CONFIG_ENABLED(MESSAGE_BUS_TRACE)
+        /**
+          * Writes the event trace to DMESG, and then clears it.
+          *
+          * The queue counters are written first, followed by one line per event id giving its latency histogram, as the
+          * id then the count in each bucket. The trace ring follows, oldest record first, as three hexadecimal words per
+          * record: the time, the id and value (id in the upper 16 bits), and the info field of MessageBusTraceRecord.
+          */
+        void traceDump();
+#endif
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_STATISTICS)
+        /**
+          * Writes the dispatch statistics of all listeners to DMESG.
+          *
+          * One line is written per listener, giving the number of times it has been invoked, the number of
+          * those invocations that blocked, and the average time spent in the handler in microseconds.
+          */
+        void listenerStatisticsDump();
+#endif
 
 
         private:
 
         Listener            *listeners;           // Chain of active listeners.
-        EventQueueItem      *evt_queue_head;    // Head of queued events to be processed.
-        EventQueueItem      *evt_queue_tail;    // Tail of queued events to be processed.
+        Event               eventQueue[MESSAGE_BUS_EVENT_QUEUE_SIZE];       // Ring buffer of queued events to be processed.
+        uint8_t             eventQueueState[MESSAGE_BUS_EVENT_QUEUE_SIZE];  // The MESSAGE_BUS_QUEUE_SLOT state of each entry of eventQueue.
         uint16_t                    nonce_val;          // The last nonce issued.
-        uint16_t                    queueLength;        // The number of events currently waiting to be processed.
+        uint16_t                    queueHead;          // The index of the oldest entry in eventQueue.
+        uint16_t                    queueLength;        // The number of entries of eventQueue in use, including those reserved.
+        uint16_t                    queuePeak;          // The largest number of entries of eventQueue that have been in use at once.
+        uint32_t                    droppedEvents;      // The number of events dropped as the queue was full.
+        uint32_t                    coalescedEvents;    // The number of events merged into an identical waiting event.
+        uint32_t                    coalesced[MESSAGE_BUS_COALESCE_MAX];    // The id (upper 16 bits) and value (lower 16 bits) of each coalesced event type.
+        uint8_t                     coalescedCount;     // The number of entries in coalesced.
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_INDEX)
+        ListenerIndexEntry          *listenerIndex;     // The distinct ids of the listeners, in increasing order, or NULL if not available.
+        uint16_t                    listenerIndexSize;  // The number of entries in listenerIndex.
+#endif
 
         /**
           * Cleanup any Listeners marked for deletion from the list.
@@ -159,6 +312,43 @@ namespace codal
           */
         int deleteMarkedListeners();
 
+        /**
+          * Delivers the given event to the given listener, if it is of the type being processed.
+          *
+          * @param l The listener, which must match the event.
+          *
+          * @param evt The event to deliver.
+          *
+          * @param urgent true if urgent listeners are being processed, false for standard listeners.
+          *
+          * @return 1 if the listener was processed, 0 if it requires further processing.
+          */
+        int deliver(Listener *l, Event &evt, bool urgent);
+
+        /**
+          * Delivers the given batch of events to all relevant standard listeners, in a single pass over the listeners.
+          *
+          * @param batch The batch to deliver.
+          */
+        void processBatch(EventBatch *batch);
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_INDEX)
+        /**
+          * Rebuilds the listener index from the list of listeners.
+          * If there is insufficient memory, the index is discarded and all listeners are visited for each event.
+          */
+        void rebuildListenerIndex();
+
+        /**
+          * Finds the first listener with the given id, using the listener index.
+          *
+          * @param id The event id.
+          *
+          * @return The first listener on the list with the given id, or NULL if there is none.
+          */
+        Listener *findListeners(uint16_t id);
+#endif
+
         /**
           * Queue the given event for processing at a later time.
           * Add the given event at the tail of our queue.
@@ -170,9 +360,44 @@ namespace codal
         /**
           * Extract the next event from the front of the event queue (if present).
           *
-          * @return a pointer to the EventQueueItem that is at the head of the list.
+          * @param evt Set to the event at the head of the queue.
+          *
+          * @return 1 if an event was extracted, 0 if there are no events ready to process.
+          */
+        int dequeueEvent(Event &evt);
+
+        /**
+          * Extract the batch of events at the front of the event queue, if the event there was raised through sendBatch().
+          *
+          * @return The batch, to be freed by the caller, or NULL if the event at the front of the queue is not part of
+          *         a complete batch, or there is insufficient memory to hold it.
+          */
+        EventBatch *dequeueBatch();
+
+        /**
+          * Determines the number of events in the batch at the front of the event queue.
+          * Must be called with interrupts disabled.
+          *
+          * @return The number of events in the batch, 0 if the event at the front of the queue is not part of a batch,
+          *         or -1 if the batch is still being queued by sendBatch().
+          */
+        int batchLength();
+
+        /**
+          * Releases any cancelled entries at either end of the event queue.
+          * Must be called with interrupts disabled.
+          */
+        void trimEventQueue();
+
+        /**
+          * Merges the given event with an identical event waiting on the event queue, if the event is configured to coalesce.
+          * Must be called with interrupts disabled.
+          *
+          * @param evt The event raised.
+          *
+          * @return 1 if the event was merged, and does not need to be queued, 0 otherwise.
           */
-        EventQueueItem* dequeueEvent();
+        int coalesceEvent(Event &evt);
 
         /**
           * Periodic callback from Device.
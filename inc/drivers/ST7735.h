@@ -65,7 +65,7 @@ protected:
 
     void sendCmd(uint8_t *buf, int len);
     void sendCmdSeq(const uint8_t *buf);
-    void sendDone(Event);
+    static void sendDone(void *st);
     void sendWords(unsigned numBytes);
     void startTransfer(unsigned size);
     void sendBytes(unsigned num);
@@ -41,12 +41,11 @@ class USBMSC : public CodalUSBInterface
     uint32_t blockAddr;
     uint16_t blockCount;
     bool failed;
-    bool listen;
     bool disableIRQ;
 
     bool writePadded(const void *ptr, int dataSize, int allocSize = -1);
-    void writeHandler(Event);
-    void readHandler(Event);
+    static void writeHandler(void *msc);
+    static void readHandler(void *msc);
 
     int handeSCSICommand();
     int sendResponse(bool ok);
@@ -26,6 +26,7 @@ DEALINGS IN THE SOFTWARE.
 #define CODAL_EVENT_H
 
 #include "CodalConfig.h"
+#include "CodalPool.h"
 
 // Wildcard event codes
 #define DEVICE_ID_ANY         0
@@ -129,6 +130,20 @@ namespace codal
           * @param evt The event to be queued.
           */
         EventQueueItem(Event evt);
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_POOL)
+        static MemoryPool pool;         // The pool EventQueueItems are allocated from.
+
+        /**
+          * Allocates memory for a new instance from the pool.
+          */
+        static void *operator new(size_t size);
+
+        /**
+          * Returns the memory of an instance to the pool.
+          */
+        static void operator delete(void *p);
+#endif
     };
 }
 
@@ -32,7 +32,7 @@ namespace codal
 {
     /**
       * Base class for payload for ref-counted objects. Used by ManagedString and DeviceImage.
-      * There is no constructor, as this struct is typically malloc()ed.
+      * There is no constructor, as this struct is typically allocated with RefCounted::allocate().
       */
     struct RefCounted
     {
@@ -75,6 +75,23 @@ namespace codal
           * @return true if the object resides in flash memory, false otherwise.
           */
         bool isReadOnly();
+
+        /**
+          * Allocates the memory for a payload. If REF_COUNTED_POOL is enabled, the payload is taken
+          * from the pool of its size class where possible, otherwise it is allocated from the heap.
+          *
+          * @param size The size of the payload in bytes, including this header.
+          *
+          * @return A pointer to the memory allocated, or NULL if there is insufficient memory.
+          */
+        static void *allocate(size_t size);
+
+        /**
+          * Releases the memory of a payload previously returned by allocate().
+          *
+          * @param p The payload to release.
+          */
+        static void deallocate(void *p);
     };
 
 
@@ -0,0 +1,132 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  * A region based allocator, for objects that share a lifetime.
+  */
+#include "CodalConfig.h"
+#include "CodalArena.h"
+
+using namespace codal;
+
+// Allocations are aligned to the largest alignment of the types held, which may include 64 bit timestamps.
+#define ARENA_ALIGNMENT             8
+
+// The space taken by the header of each chunk, preserving the alignment of the data that follows it.
+#define ARENA_HEADER_SIZE           ((sizeof(ArenaChunk) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+/**
+  * Constructor. Creates an empty arena. No memory is allocated until the first allocation is made.
+  *
+  * @param chunkSize The number of bytes to draw from the heap at a time. Allocations larger than this
+  *                  are given a chunk of their own. Defaults to CODAL_ARENA_CHUNK_SIZE.
+  */
+Arena::Arena(uint16_t chunkSize)
+{
+    this->chunks = NULL;
+    this->chunkSize = chunkSize;
+}
+
+/**
+  * Destructor. Frees all memory allocated from the arena.
+  */
+Arena::~Arena()
+{
+    reset();
+}
+
+/**
+  * Allocates memory from the arena. The memory remains valid until the arena is reset or destroyed.
+  *
+  * @param size The number of bytes required.
+  *
+  * @return A pointer to the memory allocated, or NULL if there is insufficient memory.
+  */
+void *Arena::allocate(size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    if (size == 0 || size > 0xffff - ARENA_HEADER_SIZE)
+        return NULL;
+
+    // Start a new chunk if the current one is full. Any space left at its end is simply abandoned.
+    if (chunks == NULL || (size_t)(chunks->size - chunks->used) < size)
+    {
+        uint16_t available = (uint16_t) size > chunkSize ? (uint16_t) size : chunkSize;
+        ArenaChunk *c = (ArenaChunk *) malloc(ARENA_HEADER_SIZE + available);
+
+        if (c == NULL)
+            return NULL;
+
+        c->next = chunks;
+        c->size = available;
+        c->used = 0;
+        chunks = c;
+    }
+
+    void *p = (uint8_t *)chunks + ARENA_HEADER_SIZE + chunks->used;
+    chunks->used += size;
+
+    return p;
+}
+
+/**
+  * Frees all memory allocated from the arena, returning its chunks to the heap.
+  */
+void Arena::reset()
+{
+    while (chunks)
+    {
+        ArenaChunk *c = chunks;
+        chunks = c->next;
+        free(c);
+    }
+}
+
+/**
+  * Determines the number of bytes allocated from the arena.
+  */
+uint32_t Arena::getUsed()
+{
+    uint32_t total = 0;
+
+    for (ArenaChunk *c = chunks; c; c = c->next)
+        total += c->used;
+
+    return total;
+}
+
+/**
+  * Determines the number of bytes the arena has drawn from the heap.
+  */
+uint32_t Arena::getSize()
+{
+    uint32_t total = 0;
+
+    for (ArenaChunk *c = chunks; c; c = c->next)
+        total += ARENA_HEADER_SIZE + c->size;
+
+    return total;
+}
@@ -37,19 +37,44 @@ uint8_t CodalComponent::configuration = 0;
 #error "DEVICE_COMPONENT_COUNT has to fit in uint8_t"
 #endif
 
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+static bool systemTickActive = false;
+
+/**
+  * Starts or stops the periodic component timer, depending on whether any component currently requires it.
+  */
+static void component_system_tick(bool required)
+{
+    if (required == systemTickActive)
+        return;
+
+    if (required)
+        systemTickActive = system_timer_event_every_us(SCHEDULER_TICK_PERIOD_US, DEVICE_ID_COMPONENT, DEVICE_COMPONENT_EVT_SYSTEM_TICK) == DEVICE_OK;
+    else
+    {
+        system_timer_cancel_event(DEVICE_ID_COMPONENT, DEVICE_COMPONENT_EVT_SYSTEM_TICK);
+        systemTickActive = false;
+    }
+}
+#endif
+
 /**
   * The periodic callback for all components.
   */
 void component_callback(Event evt)
 {
     uint8_t i = 0;
+    bool tickRequired = false;
 
     if(evt.value == DEVICE_COMPONENT_EVT_SYSTEM_TICK)
     {
         while(i < DEVICE_COMPONENT_COUNT)
         {
             if(CodalComponent::components[i] && CodalComponent::components[i]->status & DEVICE_COMPONENT_STATUS_SYSTEM_TICK)
+            {
                 CodalComponent::components[i]->periodicCallback();
+                tickRequired = true;
+            }
 
             i++;
         }
@@ -59,12 +84,25 @@ void component_callback(Event evt)
     {
         while(i < DEVICE_COMPONENT_COUNT)
         {
-            if(CodalComponent::components[i] && CodalComponent::components[i]->status & DEVICE_COMPONENT_STATUS_IDLE_TICK)
-                CodalComponent::components[i]->idleCallback();
+            if(CodalComponent::components[i])
+            {
+                if (CodalComponent::components[i]->status & DEVICE_COMPONENT_STATUS_IDLE_TICK)
+                    CodalComponent::components[i]->idleCallback();
+
+                if (CodalComponent::components[i]->status & DEVICE_COMPONENT_STATUS_SYSTEM_TICK)
+                    tickRequired = true;
+            }
 
             i++;
         }
     }
+
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+    // In tickless mode, only keep the periodic timer running whilst a component has asked for it.
+    component_system_tick(tickRequired);
+#else
+    (void)tickRequired;
+#endif
 }
 
 /**
@@ -88,7 +126,12 @@ void CodalComponent::addComponent()
 
     if(!(configuration & DEVICE_COMPONENT_LISTENERS_CONFIGURED) && EventModel::defaultEventBus)
     {
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+        // The periodic timer is started on demand, once a component requests DEVICE_COMPONENT_STATUS_SYSTEM_TICK.
+        int ret = system_timer ? DEVICE_OK : DEVICE_NOT_SUPPORTED;
+#else
         int ret = system_timer_event_every_us(SCHEDULER_TICK_PERIOD_US, DEVICE_ID_COMPONENT, DEVICE_COMPONENT_EVT_SYSTEM_TICK);
+#endif
 
         if(ret == DEVICE_OK)
         {
@@ -139,7 +139,7 @@ void codal_vdmesg(const char *format, bool crlf, va_list ap)
         if (*end++ == '%')
         {
             logwriten(format, end - format - 1);
-            uint32_t val = va_arg(ap, uint32_t);
+            PROCESSOR_WORD_TYPE val = va_arg(ap, PROCESSOR_WORD_TYPE);
             switch (*end++)
             {
             case 'c':
@@ -33,6 +33,8 @@ DEALINGS IN THE SOFTWARE.
 #include "CodalConfig.h"
 #include "CodalFiber.h"
 #include "Timer.h"
+#include "ManagedBuffer.h"
+#include "CodalDmesg.h"
 #include "codal_target_hal.h"
 
 #define INITIAL_STACK_DEPTH (fiber_initial_stack_base() - 0x04)
@@ -51,12 +53,42 @@ static Fiber *idleFiber = NULL;                    // the idle task - performs a
 /*
  * Scheduler state.
  */
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+static Fiber *runQueues[DEVICE_FIBER_PRIORITY_LEVELS]; // The lists of runnable fibers, one per priority level.
+static uint8_t runQueueReady = 0;                  // Bitmap of the priority levels that have runnable fibers.
+#if DEVICE_FIBER_PRIORITY_AGING > 0
+static uint8_t starvation = 0;                     // Number of consecutive scheduling decisions that have passed over lower priority fibers.
+#endif
+#else
 static Fiber *runQueue = NULL;                     // The list of runnable fibers.
+#endif
 static Fiber *sleepQueue = NULL;                   // The list of blocked fibers waiting on a fiber_sleep() operation.
 static Fiber *waitQueue = NULL;                    // The list of blocked fibers waiting on an event.
+#if CONFIG_ENABLED(DEVICE_FIBER_WAIT_INDEX)
+static Fiber *waitIndex[DEVICE_FIBER_WAIT_INDEX_SIZE]; // Blocked fibers waiting on a specific event, hashed by id and value. waitQueue then holds only wildcard waits.
+static uint32_t waitSequence = 0;                  // Order in which fibers started waiting, used to preserve NOTIFY_ONE semantics across queues.
+#endif
 static Fiber *fiberPool = NULL;                    // Pool of unused fibers, just waiting for a job to do.
 static Fiber *fiberList = NULL;                    // List of all active Fibers (excludes those in the fiberPool)
 
+#if CONFIG_ENABLED(DEVICE_FIBER_STACK_POOL)
+static void *stackPool[DEVICE_FIBER_STACK_POOL_CLASSES]; // Free stack buffers, one list per size class. Each free buffer holds a reference to the next.
+static uint8_t stackPoolSize[DEVICE_FIBER_STACK_POOL_CLASSES]; // Number of free stack buffers held in each size class.
+static uint32_t stackPoolHits = 0;                 // Number of stack allocations served from the pool.
+static uint32_t stackPoolMisses = 0;               // Number of stack allocations served from the heap.
+#endif
+
+/*
+ * Instrumentation state.
+ */
+#if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS) || DEVICE_FIBER_TRACE_SIZE > 0
+static CODAL_TIMESTAMP lastSwitchTime = 0;         // Time at which the current fiber was last scheduled in.
+#endif
+#if DEVICE_FIBER_TRACE_SIZE > 0
+static FiberTraceRecord traceBuffer[DEVICE_FIBER_TRACE_SIZE]; // Ring buffer of the most recent context switches.
+static uint32_t traceCount = 0;                    // Total number of context switches recorded.
+#endif
+
 /*
  * Scheduler wide flags
  */
@@ -66,10 +98,102 @@ static uint8_t fiber_flags = 0;
  * Fibers may perform wait/notify semantics on events. If set, these operations will be permitted on this EventModel.
  */
 static EventModel *messageBus = NULL;
+
+/*
+ * Offered NOTIFY_ONE events that no fiber was waiting on (see scheduler_set_notify_one_handler()).
+ */
+static void (*notifyOneHandler)(Event) = NULL;
+
+/*
+ * Calls waiting to be made by the scheduler before it next goes idle (see fiber_defer()).
+ */
+struct DeferredCall
+{
+    void (*fn)(void *);
+    void *arg;
+};
+
+static DeferredCall deferredQueue[SCHEDULER_DEFERRED_QUEUE_SIZE];
+static bool deferredIsReserved[SCHEDULER_DEFERRED_QUEUE_SIZE]; // true for calls in deferredQueue that use a reserved slot.
+static uint8_t deferredHead = 0;                    // The index of the oldest call in deferredQueue.
+static uint8_t deferredLength = 0;                  // The number of calls in deferredQueue.
+static uint8_t deferredReserved = 0;                // The number of slots of deferredQueue held by fiber_defer_reserve().
+static uint8_t deferredReservedUsed = 0;            // The number of calls in deferredQueue that use a reserved slot.
 }
 
 using namespace codal;
 
+/**
+  * Determines the run queue that the given fiber should be placed on when it becomes runnable.
+  *
+  * @param f The fiber to inspect.
+  *
+  * @return The run queue for the fiber's priority level.
+  */
+static inline Fiber **run_queue_for(Fiber *f)
+{
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    return &runQueues[f->priority];
+#else
+    (void)f;
+    return &runQueue;
+#endif
+}
+
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+/**
+  * Determines if the given queue is one of the run queues, and if so, updates the bitmap of ready priority levels.
+  *
+  * @param queue The queue that has just been modified.
+  */
+static inline void update_run_queue_ready(Fiber **queue)
+{
+    if (queue >= runQueues && queue < runQueues + DEVICE_FIBER_PRIORITY_LEVELS)
+    {
+        if (*queue)
+            runQueueReady |= 1 << (queue - runQueues);
+        else
+            runQueueReady &= ~(1 << (queue - runQueues));
+    }
+}
+#endif
+
+/**
+  * Determines the run queue that should be scheduled next. Normally, this is the highest priority level with runnable fibers.
+  *
+  * @return The run queue to schedule from. The queue will be empty if there are no runnable fibers.
+  */
+static Fiber **ready_run_queue()
+{
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    if (runQueueReady == 0)
+        return &runQueues[FIBER_PRIORITY_NORMAL];
+
+    int level = 31 - __builtin_clz(runQueueReady);
+
+#if DEVICE_FIBER_PRIORITY_AGING > 0
+    // If lower priority fibers are being passed over, periodically give the lowest of them a turn to ensure they never starve completely.
+    // Real time fibers are always served first.
+    if (level != FIBER_PRIORITY_REALTIME && (runQueueReady & ((1 << level) - 1)))
+    {
+        if (++starvation >= DEVICE_FIBER_PRIORITY_AGING)
+        {
+            starvation = 0;
+            level = __builtin_ctz(runQueueReady);
+        }
+    }
+    else
+    {
+        starvation = 0;
+    }
+#endif
+
+    return &runQueues[level];
+#else
+    return &runQueue;
+#endif
+}
+
 /**
   * Utility function to add the currenty running fiber to the given queue.
   *
@@ -94,23 +218,103 @@ void codal::queue_fiber(Fiber *f, Fiber **queue)
     if (*queue == NULL)
     {
         f->qnext = NULL;
+#if CONFIG_ENABLED(DEVICE_FIBER_QUEUE_TAIL)
+        f->qprev = f;
+#else
         f->qprev = NULL;
+#endif
         *queue = f;
     }
     else
     {
+#if CONFIG_ENABLED(DEVICE_FIBER_QUEUE_TAIL)
+        // The head of the queue holds a reference to the tail.
+        Fiber *last = (*queue)->qprev;
+        (*queue)->qprev = f;
+#else
         // Scan to the end of the queue.
         // We don't maintain a tail pointer to save RAM (queues are nrmally very short).
         Fiber *last = *queue;
 
         while (last->qnext != NULL)
             last = last->qnext;
+#endif
 
         last->qnext = f;
         f->qprev = last;
         f->qnext = NULL;
     }
 
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    update_run_queue_ready(queue);
+#endif
+
+    target_enable_irq();
+}
+
+/**
+  * Utility function to add the given fiber to a queue held in ascending order of its context field.
+  *
+  * Used to maintain the sleep queue sorted by wake up time, such that the scheduler need only
+  * inspect the head of the queue to determine if any fibers are due to be woken.
+  * Fibers with equal context values are held in the order in which they were queued.
+  *
+  * @param f The fiber to add to the queue
+  *
+  * @param queue The queue to add the fiber to.
+  */
+static void queue_fiber_ordered(Fiber *f, Fiber **queue)
+{
+    target_disable_irq();
+
+#if CONFIG_ENABLED(DEVICE_FIBER_QUEUE_TAIL)
+    // Fibers are commonly due after all those already queued, in which case a simple append will do.
+    if (*queue == NULL || (*queue)->qprev->context <= f->context)
+    {
+        queue_fiber(f, queue);
+        target_enable_irq();
+        return;
+    }
+#endif
+
+    // Record which queue this fiber is on.
+    f->queue = queue;
+
+    // Find the first fiber that is due strictly after this one.
+    Fiber *prev = NULL;
+    Fiber *next = *queue;
+
+    while (next != NULL && next->context <= f->context)
+    {
+        prev = next;
+        next = next->qnext;
+    }
+
+    f->qnext = next;
+
+    if (prev == NULL)
+    {
+#if CONFIG_ENABLED(DEVICE_FIBER_QUEUE_TAIL)
+        // Inherit the reference to the tail from the old head.
+        f->qprev = next != NULL ? next->qprev : f;
+#else
+        f->qprev = NULL;
+#endif
+        *queue = f;
+    }
+    else
+    {
+        f->qprev = prev;
+        prev->qnext = f;
+    }
+
+    if (next != NULL)
+        next->qprev = f;
+#if CONFIG_ENABLED(DEVICE_FIBER_QUEUE_TAIL)
+    else
+        (*queue)->qprev = f;
+#endif
+
     target_enable_irq();
 }
 
@@ -128,6 +332,27 @@ void codal::dequeue_fiber(Fiber *f)
     // Remove this fiber fromm whichever queue it is on.
     target_disable_irq();
 
+#if CONFIG_ENABLED(DEVICE_FIBER_QUEUE_TAIL)
+    Fiber *head = *(f->queue);
+
+    if (f == head)
+    {
+        // The new head (if any) inherits the reference to the tail.
+        *(f->queue) = f->qnext;
+
+        if (f->qnext)
+            f->qnext->qprev = f->qprev;
+    }
+    else
+    {
+        f->qprev->qnext = f->qnext;
+
+        if (f->qnext)
+            f->qnext->qprev = f->qprev;
+        else
+            head->qprev = f->qprev;
+    }
+#else
     if (f->qprev != NULL)
         f->qprev->qnext = f->qnext;
     else
@@ -135,6 +360,11 @@ void codal::dequeue_fiber(Fiber *f)
 
     if(f->qnext)
         f->qnext->qprev = f->qprev;
+#endif
+
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    update_run_queue_ready(f->queue);
+#endif
 
     f->qnext = NULL;
     f->qprev = NULL;
@@ -187,10 +417,20 @@ Fiber *getFiberContext()
     // Ensure this fiber is in suitable state for reuse.
     f->flags = 0;
 
+    #if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    f->priority = FIBER_PRIORITY_NORMAL;
+    #endif
+
     #if CONFIG_ENABLED(DEVICE_FIBER_USER_DATA)
     f->user_data = 0;
     #endif
 
+    #if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS)
+    f->run_time = 0;
+    f->switch_count = 0;
+    f->max_stack_depth = 0;
+    #endif
+
     tcb_configure_stack_base(f->tcb, fiber_initial_stack_base());
 
     // Add the new Fiber to the list of all fibers
@@ -225,7 +465,7 @@ void codal::scheduler_init(EventModel &_messageBus)
     currentFiber = getFiberContext();
 
     // Add ourselves to the run queue.
-    queue_fiber(currentFiber, &runQueue);
+    queue_fiber(currentFiber, run_queue_for(currentFiber));
 
     // Create the IDLE fiber.
     // Configure the fiber to directly enter the idle task.
@@ -236,11 +476,19 @@ void codal::scheduler_init(EventModel &_messageBus)
 
     if (messageBus)
     {
+#if CONFIG_ENABLED(SCHEDULER_LISTEN_ALL_EVENTS)
+        // Register once to receive all events, including those in the NOTIFY channel used to implement wait-notify semantics.
+        // Fibers can then wait on any event without registering a listener of their own.
+        messageBus->listen(DEVICE_ID_ANY, DEVICE_EVT_ANY, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+#else
         // Register to receive events in the NOTIFY channel - this is used to implement wait-notify semantics
         messageBus->listen(DEVICE_ID_NOTIFY, DEVICE_EVT_ANY, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
         messageBus->listen(DEVICE_ID_NOTIFY_ONE, DEVICE_EVT_ANY, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+#endif
 
+#if !CONFIG_ENABLED(SCHEDULER_TICKLESS)
         system_timer_event_every_us(SCHEDULER_TICK_PERIOD_US, DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_TICK);
+#endif
         messageBus->listen(DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_TICK, scheduler_tick, MESSAGE_BUS_LISTENER_IMMEDIATE);
     }
 
@@ -260,34 +508,82 @@ int codal::fiber_scheduler_running()
     return 0;
 }
 
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+// Set if the timer had no room for the last scheduler wake up we tried to arm.
+static bool wakeupFailed = false;
+
+/**
+  * Arms a single timer event for the wake up time of the fiber at the head of the sleep queue,
+  * replacing any previously armed scheduler wake up.
+  */
+static void scheduler_arm_wakeup()
+{
+    target_disable_irq();
+
+    system_timer_cancel_event(DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_TICK);
+    wakeupFailed = false;
+
+    if (sleepQueue != NULL)
+    {
+        CODAL_TIMESTAMP now = system_timer_current_time();
+        CODAL_TIMESTAMP period = sleepQueue->context > now ? sleepQueue->context - now : 0;
+
+        wakeupFailed = system_timer_event_after_us(period * 1000, DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_TICK) != DEVICE_OK;
+    }
+
+    target_enable_irq();
+}
+#endif
+
+#if CONFIG_ENABLED(DEVICE_FIBER_WAIT_INDEX)
+/**
+  * Determines the wait queue used to hold fibers blocked on the given event.
+  *
+  * @param id The ID field of the event.
+  *
+  * @param value The value field of the event.
+  *
+  * @return The wildcard waitQueue if either field is a wildcard, otherwise the waitIndex bucket for the event.
+  */
+static Fiber **wait_queue_for(uint16_t id, uint16_t value)
+{
+    if (id == DEVICE_ID_ANY || value == DEVICE_EVT_ANY)
+        return &waitQueue;
+
+    return &waitIndex[(id * 31 + value) % DEVICE_FIBER_WAIT_INDEX_SIZE];
+}
+#endif
+
 /**
   * The timer callback, called from interrupt context once every SYSTEM_TICK_PERIOD_MS milliseconds.
   * This function checks to determine if any fibers blocked on the sleep queue need to be woken up
   * and made runnable.
+  *
+  * In tickless mode (SCHEDULER_TICKLESS), this is instead called once the earliest sleeping fiber is due.
   */
 void codal::scheduler_tick(Event evt)
 {
     Fiber *f = sleepQueue;
-    Fiber *t;
 
 #if !CONFIG_ENABLED(LIGHTWEIGHT_EVENTS)
     evt.timestamp /= 1000;
 #endif
 
     // Check the sleep queue, and wake up any fibers as necessary.
-    while (f != NULL)
+    // The sleep queue is held in order of wake up time, so we can stop at the first fiber that isn't yet due.
+    while (f != NULL && evt.timestamp >= f->context)
     {
-        t = f->qnext;
-
-        if (evt.timestamp >= f->context)
-        {
-            // Wakey wakey!
-            dequeue_fiber(f);
-            queue_fiber(f,&runQueue);
-        }
+        // Wakey wakey!
+        dequeue_fiber(f);
+        queue_fiber(f, run_queue_for(f));
 
-        f = t;
+        f = sleepQueue;
     }
+
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+    // Our one shot wake up has been consumed, so arm another for the next sleeping fiber (if any).
+    scheduler_arm_wakeup();
+#endif
 }
 
 /**
@@ -310,6 +606,78 @@ void codal::scheduler_event(Event evt)
     if (messageBus == NULL)
         return;
 
+#if CONFIG_ENABLED(DEVICE_FIBER_WAIT_INDEX)
+    Fiber *notifyOne = NULL;
+
+    // Wake up any fibers waiting on exactly this event. Other fibers may share the bucket, so check each one.
+    f = *wait_queue_for(evt.source, evt.value);
+
+    while (f != NULL)
+    {
+        t = f->qnext;
+
+        if (f->context == ((uint32_t)evt.value << 16 | evt.source))
+        {
+            // Wakey wakey!
+            dequeue_fiber(f);
+            queue_fiber(f, run_queue_for(f));
+        }
+
+        f = t;
+    }
+
+    // Special case for the NOTIFY_ONE channel. Find the longest waiting fiber blocked on the equivalent NOTIFY event...
+    if (evt.source == DEVICE_ID_NOTIFY_ONE)
+    {
+        uint32_t context = (uint32_t)evt.value << 16 | DEVICE_ID_NOTIFY;
+
+        for (f = *wait_queue_for(DEVICE_ID_NOTIFY, evt.value); f != NULL && notifyOne == NULL; f = f->qnext)
+            if (f->context == context)
+                notifyOne = f;
+    }
+
+    // Now check the wildcard wait queue.
+    f = waitQueue;
+
+    while (f != NULL)
+    {
+        t = f->qnext;
+
+        // extract the event data this fiber is blocked on.
+        uint16_t id = f->context & 0xFFFF;
+        uint16_t value = (f->context & 0xFFFF0000) >> 16;
+
+        // ... which may also be a fiber waiting on any NOTIFY event, if it has waited for longer.
+        if (evt.source == DEVICE_ID_NOTIFY_ONE && id == DEVICE_ID_NOTIFY)
+        {
+            if (!notifyOneComplete)
+            {
+                if (notifyOne == NULL || (int32_t)(f->wait_seq - notifyOne->wait_seq) < 0)
+                    notifyOne = f;
+
+                notifyOneComplete = 1;
+            }
+        }
+
+        // Normal case.
+        else if ((id == DEVICE_ID_ANY || id == evt.source) && (value == DEVICE_EVT_ANY || value == evt.value))
+        {
+            // Wakey wakey!
+            dequeue_fiber(f);
+            queue_fiber(f, run_queue_for(f));
+        }
+
+        f = t;
+    }
+
+    if (notifyOne)
+    {
+        // Wakey wakey!
+        dequeue_fiber(notifyOne);
+        queue_fiber(notifyOne, run_queue_for(notifyOne));
+        notifyOneComplete = 1;
+    }
+#else
     // Check the wait queue, and wake up any fibers as necessary.
     while (f != NULL)
     {
@@ -326,7 +694,7 @@ void codal::scheduler_event(Event evt)
             {
                 // Wakey wakey!
                 dequeue_fiber(f);
-                queue_fiber(f,&runQueue);
+                queue_fiber(f, run_queue_for(f));
                 notifyOneComplete = 1;
             }
         }
@@ -336,15 +704,33 @@ void codal::scheduler_event(Event evt)
         {
             // Wakey wakey!
             dequeue_fiber(f);
-            queue_fiber(f,&runQueue);
+            queue_fiber(f, run_queue_for(f));
         }
 
         f = t;
     }
+#endif
+
+    // If no fiber was waiting to be notified, the event may still wake one other waiter (e.g. a Task).
+    if (evt.source == DEVICE_ID_NOTIFY_ONE && !notifyOneComplete && notifyOneHandler)
+        notifyOneHandler(evt);
 
+#if !CONFIG_ENABLED(SCHEDULER_LISTEN_ALL_EVENTS)
     // Unregister this event, as we've woken up all the fibers with this match.
     if (evt.source != DEVICE_ID_NOTIFY && evt.source != DEVICE_ID_NOTIFY_ONE)
         messageBus->ignore(evt.source, evt.value, scheduler_event);
+#endif
+}
+
+/**
+  * Registers a function to be offered each NOTIFY_ONE event that no fiber is waiting on. This keeps the
+  * decision of which single waiter is notified in one place: fibers are always notified first.
+  *
+  * @param handler The function to call with the event, or NULL to remove any handler registered.
+  */
+void codal::scheduler_set_notify_one_handler(void (*handler)(Event evt))
+{
+    notifyOneHandler = handler;
 }
 
 static Fiber* handle_fob()
@@ -367,6 +753,9 @@ static Fiber* handle_fob()
 #if CONFIG_ENABLED(DEVICE_FIBER_USER_DATA)
             forkedFiber->user_data = f->user_data;
             f->user_data = NULL;
+#endif
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+            forkedFiber->priority = f->priority;
 #endif
             f = forkedFiber;
         }
@@ -402,7 +791,13 @@ void codal::fiber_sleep(unsigned long t)
     dequeue_fiber(f);
 
     // Add fiber to the sleep queue. We maintain strict ordering here to reduce lookup times.
-    queue_fiber(f, &sleepQueue);
+    queue_fiber_ordered(f, &sleepQueue);
+
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+    // If we're now the first fiber due to wake, bring the scheduler wake up forward.
+    if (sleepQueue == f)
+        scheduler_arm_wakeup();
+#endif
 
     // Finally, enter the scheduler.
     schedule();
@@ -468,17 +863,135 @@ int codal::fiber_wake_on_event(uint16_t id, uint16_t value)
     // Remove ourselves from the run queue
     dequeue_fiber(f);
 
+#if CONFIG_ENABLED(DEVICE_FIBER_WAIT_INDEX)
+    // Add ourselves to the wait queue for this event, recording the order in which we started waiting.
+    f->wait_seq = waitSequence++;
+    queue_fiber(f, wait_queue_for(id, value));
+#else
     // Add ourselves to the sleep queue. We maintain strict ordering here to reduce lookup times.
     queue_fiber(f, &waitQueue);
+#endif
 
+#if CONFIG_ENABLED(SCHEDULER_LISTEN_ALL_EVENTS)
+    // scheduler_event() receives every event, so there is nothing to register. Announce the wait as registering
+    // would have, so that components that start up once something listens to them still do so.
+    if (id != DEVICE_ID_NOTIFY && id != DEVICE_ID_NOTIFY_ONE)
+        Event(DEVICE_ID_MESSAGE_BUS_LISTENER, id);
+#else
     // Register to receive this event, so we can wake up the fiber when it happens.
     // Special case for the notify channel, as we always stay registered for that.
     if (id != DEVICE_ID_NOTIFY && id != DEVICE_ID_NOTIFY_ONE)
         messageBus->listen(id, value, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+#endif
 
     return DEVICE_OK;
 }
 
+/**
+  * Schedules the given function to be called in thread context, before the scheduler next goes idle.
+  *
+  * This is intended for drivers that need to move work out of interrupt context, and is lighter than
+  * raising an event for the purpose, as no listener is needed and the MessageBus is not involved.
+  * Calls are made in the order they were deferred, from a fork on block context, so may block.
+  *
+  * This function may be called from interrupt context.
+  *
+  * @param fn The function to call.
+  *
+  * @param arg The parameter to pass to fn.
+  *
+  * @param reserved If true, the call uses a slot previously reserved by fiber_defer_reserve(), rather than one of
+  *        the slots shared by all callers. A caller that never has more calls outstanding than it has reserved
+  *        slots can rely on this succeeding.
+  *
+  * @return DEVICE_OK, DEVICE_INVALID_PARAMETER if fn is NULL, or DEVICE_NO_RESOURCES if all the slots
+  *         available to the call are already in use.
+  */
+int codal::fiber_defer(void (*fn)(void *), void *arg, bool reserved)
+{
+    int result = DEVICE_OK;
+
+    if (fn == NULL)
+        return DEVICE_INVALID_PARAMETER;
+
+    target_disable_irq();
+
+    // Calls without a reservation may not take any of the reserved slots, whether or not they are in use.
+    bool available = reserved ? deferredReservedUsed < deferredReserved : deferredLength - deferredReservedUsed + deferredReserved < SCHEDULER_DEFERRED_QUEUE_SIZE;
+
+    if (available)
+    {
+        int i = (deferredHead + deferredLength) % SCHEDULER_DEFERRED_QUEUE_SIZE;
+
+        deferredQueue[i].fn = fn;
+        deferredQueue[i].arg = arg;
+        deferredIsReserved[i] = reserved;
+        deferredLength++;
+
+        if (reserved)
+            deferredReservedUsed++;
+    }
+    else
+    {
+        result = DEVICE_NO_RESOURCES;
+    }
+
+    target_enable_irq();
+
+    return result;
+}
+
+/**
+  * Permanently reserves a slot on the deferred call queue, for use by calls to fiber_defer() with reserved set.
+  *
+  * A driver that defers a single completion at a time (e.g. the end of a transfer) can reserve a slot when it
+  * is created, so that the completion is never lost, however busy the queue is. Each reservation reduces the
+  * number of slots shared by other callers by one.
+  *
+  * @return DEVICE_OK, or DEVICE_NO_RESOURCES if every slot is already reserved, or in use by calls without a reservation.
+  */
+int codal::fiber_defer_reserve()
+{
+    int result = DEVICE_OK;
+
+    target_disable_irq();
+
+    if (deferredLength - deferredReservedUsed + deferredReserved < SCHEDULER_DEFERRED_QUEUE_SIZE)
+        deferredReserved++;
+    else
+        result = DEVICE_NO_RESOURCES;
+
+    target_enable_irq();
+
+    return result;
+}
+
+/**
+  * Makes the calls waiting on the deferred call queue. Calls deferred whilst this runs wait for the next pass,
+  * so that a call that defers itself cannot hold the scheduler here.
+  */
+static void run_deferred_calls()
+{
+    int count = deferredLength;
+
+    while (count--)
+    {
+        target_disable_irq();
+
+        DeferredCall c = deferredQueue[deferredHead];
+
+        if (deferredIsReserved[deferredHead])
+            deferredReservedUsed--;
+
+        deferredHead = (deferredHead + 1) % SCHEDULER_DEFERRED_QUEUE_SIZE;
+        deferredLength--;
+
+        target_enable_irq();
+
+        invoke(c.fn, c.arg);
+    }
+}
+
 #if CONFIG_ENABLED(DEVICE_FIBER_USER_DATA)
 #define HAS_THREAD_USER_DATA (currentFiber->user_data != NULL)
 #else
@@ -656,7 +1169,7 @@ void codal::launch_new_fiber_param(void (*ep)(void *), void (*cp)(void *), void
 }
 
 
-Fiber *__create_fiber(uint32_t ep, uint32_t cp, uint32_t pm, int parameterised)
+Fiber *__create_fiber(PROCESSOR_WORD_TYPE ep, PROCESSOR_WORD_TYPE cp, PROCESSOR_WORD_TYPE pm, int parameterised, FiberPriority priority)
 {
     // Validate our parameters.
     if (ep == 0 || cp == 0)
@@ -670,12 +1183,18 @@ Fiber *__create_fiber(uint32_t ep, uint32_t cp, uint32_t pm, int parameterised)
     if (newFiber == NULL)
         return NULL;
 
+    #if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    newFiber->priority = priority;
+    #else
+    (void)priority;
+    #endif
+
     tcb_configure_args(newFiber->tcb, ep, cp, pm);
     tcb_configure_sp(newFiber->tcb, INITIAL_STACK_DEPTH);
     tcb_configure_lr(newFiber->tcb, parameterised ? (PROCESSOR_WORD_TYPE) &launch_new_fiber_param : (PROCESSOR_WORD_TYPE) &launch_new_fiber);
 
     // Add new fiber to the run queue.
-    queue_fiber(newFiber, &runQueue);
+    queue_fiber(newFiber, run_queue_for(newFiber));
 
     return newFiber;
 }
@@ -695,7 +1214,27 @@ Fiber *codal::create_fiber(void (*entry_fn)(void), void (*completion_fn)(void))
     if (!fiber_scheduler_running())
         return NULL;
 
-    return __create_fiber((uint32_t) entry_fn, (uint32_t)completion_fn, 0, 0);
+    return __create_fiber((PROCESSOR_WORD_TYPE) entry_fn, (PROCESSOR_WORD_TYPE)completion_fn, 0, 0, FIBER_PRIORITY_NORMAL);
+}
+
+/**
+  * Creates a new Fiber with the given scheduling priority, and launches it.
+  *
+  * @param entry_fn The function the new Fiber will begin execution in.
+  *
+  * @param priority The priority level of the new Fiber. Ignored unless DEVICE_FIBER_PRIORITY is enabled.
+  *
+  * @param completion_fn The function called when the thread completes execution of entry_fn.
+  *                      Defaults to release_fiber.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  */
+Fiber *codal::create_fiber(void (*entry_fn)(void), FiberPriority priority, void (*completion_fn)(void))
+{
+    if (!fiber_scheduler_running())
+        return NULL;
+
+    return __create_fiber((PROCESSOR_WORD_TYPE) entry_fn, (PROCESSOR_WORD_TYPE)completion_fn, 0, 0, priority);
 }
 
 
@@ -716,9 +1255,143 @@ Fiber *codal::create_fiber(void (*entry_fn)(void *), void *param, void (*complet
     if (!fiber_scheduler_running())
         return NULL;
 
-    return __create_fiber((uint32_t) entry_fn, (uint32_t)completion_fn, (uint32_t) param, 1);
+    return __create_fiber((PROCESSOR_WORD_TYPE) entry_fn, (PROCESSOR_WORD_TYPE)completion_fn, (PROCESSOR_WORD_TYPE) param, 1, FIBER_PRIORITY_NORMAL);
 }
 
+/**
+  * Creates a new parameterised Fiber with the given scheduling priority, and launches it.
+  *
+  * @param entry_fn The function the new Fiber will begin execution in.
+  *
+  * @param param an untyped parameter passed into the entry_fn and completion_fn.
+  *
+  * @param priority The priority level of the new Fiber. Ignored unless DEVICE_FIBER_PRIORITY is enabled.
+  *
+  * @param completion_fn The function called when the thread completes execution of entry_fn.
+  *                      Defaults to release_fiber.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  */
+Fiber *codal::create_fiber(void (*entry_fn)(void *), void *param, FiberPriority priority, void (*completion_fn)(void *))
+{
+    if (!fiber_scheduler_running())
+        return NULL;
+
+    return __create_fiber((PROCESSOR_WORD_TYPE) entry_fn, (PROCESSOR_WORD_TYPE)completion_fn, (PROCESSOR_WORD_TYPE) param, 1, priority);
+}
+
+/**
+  * Allocates a buffer to hold the stack of a fiber.
+  *
+  * @param depth The stack depth the buffer must be able to hold, in bytes.
+  *
+  * @param size Updated with the size of the allocated buffer, in bytes.
+  *
+  * @return The address of the buffer, or 0 if no memory is available.
+  */
+static PROCESSOR_WORD_TYPE stack_allocate(PROCESSOR_WORD_TYPE depth, PROCESSOR_WORD_TYPE *size)
+{
+#if CONFIG_ENABLED(DEVICE_FIBER_STACK_POOL)
+    // Choose the smallest size class that fits. Classes double in size, so a growing stack is reallocated only a few times.
+    PROCESSOR_WORD_TYPE classSize = DEVICE_FIBER_STACK_POOL_MIN_SIZE;
+
+    for (int i = 0; i < DEVICE_FIBER_STACK_POOL_CLASSES; i++, classSize <<= 1)
+    {
+        if (classSize < depth)
+            continue;
+
+        *size = classSize;
+
+        target_disable_irq();
+        void *b = stackPool[i];
+        if (b)
+        {
+            stackPool[i] = *(void **)b;
+            stackPoolSize[i]--;
+            stackPoolHits++;
+        }
+        else
+        {
+            stackPoolMisses++;
+        }
+        target_enable_irq();
+
+        return (PROCESSOR_WORD_TYPE)(b ? b : malloc(classSize));
+    }
+
+    stackPoolMisses++;
+#endif
+
+    // To ease heap churn, we choose the next largest multple of 32 bytes.
+    *size = (depth + 32) & 0xffffffe0;
+
+    return (PROCESSOR_WORD_TYPE)malloc(*size);
+}
+
+/**
+  * Releases a buffer previously allocated by stack_allocate().
+  *
+  * @param bottom The address of the buffer, or 0 if none.
+  *
+  * @param size The size of the buffer, in bytes.
+  */
+static void stack_release(PROCESSOR_WORD_TYPE bottom, PROCESSOR_WORD_TYPE size)
+{
+    if (bottom == 0)
+        return;
+
+#if CONFIG_ENABLED(DEVICE_FIBER_STACK_POOL)
+    PROCESSOR_WORD_TYPE classSize = DEVICE_FIBER_STACK_POOL_MIN_SIZE;
+
+    for (int i = 0; i < DEVICE_FIBER_STACK_POOL_CLASSES; i++, classSize <<= 1)
+    {
+        if (classSize != size)
+            continue;
+
+        target_disable_irq();
+        if (stackPoolSize[i] < DEVICE_FIBER_STACK_POOL_DEPTH)
+        {
+            *(void **)bottom = stackPool[i];
+            stackPool[i] = (void *)bottom;
+            stackPoolSize[i]++;
+            bottom = 0;
+        }
+        target_enable_irq();
+
+        break;
+    }
+
+    if (bottom == 0)
+        return;
+#else
+    (void)size;
+#endif
+
+    free((void *)bottom);
+}
+
+#if CONFIG_ENABLED(DEVICE_FIBER_STACK_POOL)
+/**
+ * Determines the number of fiber stack allocations served from the stack pool.
+ *
+ * @return The number of stack allocations that reused a pooled buffer.
+ */
+uint32_t codal::fiber_stack_pool_hits()
+{
+    return stackPoolHits;
+}
+
+/**
+ * Determines the number of fiber stack allocations that could not be served from the stack pool.
+ *
+ * @return The number of stack allocations that required a heap allocation.
+ */
+uint32_t codal::fiber_stack_pool_misses()
+{
+    return stackPoolMisses;
+}
+#endif
+
 /**
   * Exit point for all fibers.
   *
@@ -748,18 +1421,19 @@ void codal::release_fiber(void)
     // Add ourselves to the list of free fibers
     queue_fiber(currentFiber, &fiberPool);
 
-    // limit the number of fibers in the pool
+    // limit the number of fibers in the pool, by releasing the one that has been unused for longest.
+    // n.b. This is never the current fiber, which has just been added to the tail of the pool, and is still running.
     int numFree = 0;
-    for (Fiber *p = fiberPool; p; p = p->qnext) {
-        if (!p->qnext && numFree > 3) {
-            p->qprev->qnext = NULL;
-            free(p->tcb);
-            free((void *)p->stack_bottom);
-            memset(p, 0, sizeof(*p));
-            free(p);
-            break;
-        }
+    for (Fiber *p = fiberPool; p; p = p->qnext)
         numFree++;
+
+    if (numFree > 4) {
+        Fiber *p = fiberPool;
+        dequeue_fiber(p);
+        free(p->tcb);
+        stack_release(p->stack_bottom, p->stack_top - p->stack_bottom);
+        memset(p, 0, sizeof(*p));
+        free(p);
     }
 
     // Reset fiber state, to ensure it can be safely reused.
@@ -812,6 +1486,11 @@ void codal::verify_stack_size(Fiber *f)
     // Calculate the stack depth.
     stackDepth = tcb_get_stack_base(f->tcb) - (PROCESSOR_WORD_TYPE)get_current_sp();
 
+#if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS)
+    if (stackDepth > f->max_stack_depth)
+        f->max_stack_depth = stackDepth;
+#endif
+
     // Calculate the size of our allocated stack buffer
     bufferSize = f->stack_top - f->stack_bottom;
 
@@ -824,15 +1503,11 @@ void codal::verify_stack_size(Fiber *f)
         Fiber *prevCurrFiber = currentFiber;
         currentFiber = f;
 
-        // To ease heap churn, we choose the next largest multple of 32 bytes.
-        bufferSize = (stackDepth + 32) & 0xffffffe0;
-
         // Release the old memory
-        if (f->stack_bottom != 0)
-            free((void *)f->stack_bottom);
+        stack_release(f->stack_bottom, bufferSize);
 
         // Allocate a new one of the appropriate size.
-        f->stack_bottom = (PROCESSOR_WORD_TYPE)malloc(bufferSize);
+        f->stack_bottom = stack_allocate(stackDepth, &bufferSize);
 
         // Recalculate where the top of the stack is and we're done.
         f->stack_top = f->stack_bottom + bufferSize;
@@ -848,9 +1523,45 @@ void codal::verify_stack_size(Fiber *f)
   */
 int codal::scheduler_runqueue_empty()
 {
+#if CONFIG_ENABLED(DEVICE_FIBER_PRIORITY)
+    return (runQueueReady == 0);
+#else
     return (runQueue == NULL);
+#endif
 }
 
+#if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS) || DEVICE_FIBER_TRACE_SIZE > 0
+/**
+  * Records a context switch in the CPU accounting of the fibers involved and in the trace buffer.
+  *
+  * Time spent running the idle task is accounted to the idle fiber, unless it is run on the stack of
+  * a DEVICE_FIBER_FLAG_DO_NOT_PAGE fiber, in which case it is accounted to that fiber.
+  *
+  * @param from The fiber being scheduled out.
+  *
+  * @param to The fiber being scheduled in.
+  */
+static void scheduler_record_switch(Fiber *from, Fiber *to)
+{
+    CODAL_TIMESTAMP now = system_timer_current_time_us();
+
+#if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS)
+    from->run_time += now - lastSwitchTime;
+    to->switch_count++;
+#endif
+
+#if DEVICE_FIBER_TRACE_SIZE > 0
+    FiberTraceRecord *r = &traceBuffer[traceCount % DEVICE_FIBER_TRACE_SIZE];
+    r->timestamp = now;
+    r->from = from;
+    r->to = to;
+    traceCount++;
+#endif
+
+    lastSwitchTime = now;
+}
+#endif
+
 /**
   * Calls the Fiber scheduler.
   * The calling Fiber will likely be blocked, and control given to another waiting fiber.
@@ -898,19 +1609,10 @@ void codal::schedule()
     }
 
     // We're in a normal scheduling context, so perform a round robin algorithm across runnable fibers.
-    // OK - if we've nothing to do, then run the IDLE task (power saving sleep)
-    if (runQueue == NULL)
-        currentFiber = idleFiber;
-
-    else if (currentFiber->queue == &runQueue)
-        // If the current fiber is on the run queue, round robin.
-        currentFiber = currentFiber->qnext == NULL ? runQueue : currentFiber->qnext;
-
-    else
-        // Otherwise, just pick the head of the run queue.
-        currentFiber = runQueue;
-
-    if (currentFiber == idleFiber && oldFiber->flags & DEVICE_FIBER_FLAG_DO_NOT_PAGE)
+    // If priorities are enabled, this is performed across the fibers of the highest priority level that has any.
+    // ready_run_queue() is only called once we know there is something to run, as each call is one scheduling decision
+    // as far as priority aging is concerned.
+    if (scheduler_runqueue_empty() && oldFiber->flags & DEVICE_FIBER_FLAG_DO_NOT_PAGE)
     {
         // Run the idle task right here using the old fiber's stack.
         // Keep idling while the runqueue is empty, or there is data to process.
@@ -923,17 +1625,37 @@ void codal::schedule()
         {
             idle();
         }
-        while (runQueue == NULL);
+        while (scheduler_runqueue_empty());
 
         // Switch to a non-idle fiber.
         // If this fiber is the same as the old one then there'll be no switching at all.
-        currentFiber = runQueue;
+        currentFiber = *ready_run_queue();
+    }
+    else if (scheduler_runqueue_empty())
+    {
+        // OK - if we've nothing to do, then run the IDLE task (power saving sleep)
+        currentFiber = idleFiber;
+    }
+    else
+    {
+        Fiber **readyQueue = ready_run_queue();
+
+        if (currentFiber->queue == readyQueue)
+            // If the current fiber is on the run queue, round robin.
+            currentFiber = currentFiber->qnext == NULL ? *readyQueue : currentFiber->qnext;
+
+        else
+            // Otherwise, just pick the head of the run queue.
+            currentFiber = *readyQueue;
     }
 
     // Swap to the context of the chosen fiber, and we're done.
     // Don't bother with the overhead of switching if there's only one fiber on the runqueue!
     if (currentFiber != oldFiber)
     {
+#if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS) || DEVICE_FIBER_TRACE_SIZE > 0
+        scheduler_record_switch(oldFiber, currentFiber);
+#endif
 
         // Special case for the idle task, as we don't maintain a stack context (just to save memory).
         if (currentFiber == idleFiber)
@@ -965,6 +1687,17 @@ void codal::schedule()
   */
 void codal::idle()
 {
+    // Bottom half work deferred by drivers comes first, as it may well make fibers runnable.
+    if (deferredLength)
+        run_deferred_calls();
+
+#if CONFIG_ENABLED(SCHEDULER_TICKLESS)
+    // Without a periodic tick, a sleeping fiber is only woken by its own timer event. If the timer event list was full
+    // when that was armed, try again now that any deferred growth of the list has run.
+    if (wakeupFailed)
+        scheduler_arm_wakeup();
+#endif
+
     // Prevent an idle loop of death:
     // We will return to idle after processing any idle events that add anything
     // to our run queue, we use the DEVICE_SCHEDULER_IDLE flag to determine this
@@ -1000,6 +1733,53 @@ void codal::idle_task()
     }
 }
 
+#if CONFIG_ENABLED(DEVICE_FIBER_STATISTICS)
+/**
+ * Writes the CPU accounting information of all active fibers to DMESG.
+ *
+ * One line is written per fiber, giving its cumulative run time in microseconds, the number of
+ * times it has been scheduled in, and the deepest stack observed when it was scheduled out.
+ */
+void codal::fiber_statistics_dump()
+{
+    for (Fiber *f = fiberList; f; f = f->next)
+        DMESG("FIBER %p%s: run %d us, switches %d, stack %d", f, f == idleFiber ? " (idle)" : "", (uint32_t)f->run_time, f->switch_count, f->max_stack_depth);
+}
+#endif
+
+#if DEVICE_FIBER_TRACE_SIZE > 0
+/**
+ * Writes the content of the scheduler trace buffer to DMESG, oldest context switch first.
+ */
+void codal::fiber_trace_dump()
+{
+    ManagedBuffer b = fiber_trace_buffer();
+    FiberTraceRecord *r = (FiberTraceRecord *)b.getBytes();
+    int count = b.length() / sizeof(FiberTraceRecord);
+
+    for (int i = 0; i < count; i++)
+        DMESG("SWITCH %d: %p -> %p", (uint32_t)r[i].timestamp, r[i].from, r[i].to);
+}
+
+/**
+ * Provides a copy of the scheduler trace buffer.
+ *
+ * @return A ManagedBuffer containing an array of FiberTraceRecord, oldest context switch first.
+ */
+ManagedBuffer codal::fiber_trace_buffer()
+{
+    uint32_t length = traceCount < DEVICE_FIBER_TRACE_SIZE ? traceCount : DEVICE_FIBER_TRACE_SIZE;
+    ManagedBuffer b(length * sizeof(FiberTraceRecord));
+    FiberTraceRecord *r = (FiberTraceRecord *)b.getBytes();
+
+    // Unroll the ring buffer, such that the oldest record comes first.
+    for (uint32_t i = 0; i < length; i++)
+        r[i] = traceBuffer[(traceCount - length + i) % DEVICE_FIBER_TRACE_SIZE];
+
+    return b;
+}
+#endif
+
 /**
  * Create a new lock that can be used for mutual exclusion and condition synchronisation.
  */
@@ -1045,7 +1825,7 @@ void FiberLock::wait()
             dequeue_fiber(f);
 
             // Add fiber to the sleep queue. We maintain strict ordering here to reduce lookup times.
-            queue_fiber(f, &runQueue);
+            queue_fiber(f, run_queue_for(f));
         }
         target_enable_irq();
 
@@ -1064,7 +1844,7 @@ void FiberLock::notify()
     if (f)
     {
         dequeue_fiber(f);
-        queue_fiber(f, &runQueue);
+        queue_fiber(f, run_queue_for(f));
     }
 
     if (locked > 0)
@@ -1081,7 +1861,7 @@ void FiberLock::notifyAll()
     while (f)
     {
         dequeue_fiber(f);
-        queue_fiber(f, &runQueue);
+        queue_fiber(f, run_queue_for(f));
         f = queue;
     }
 
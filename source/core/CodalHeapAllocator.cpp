@@ -44,7 +44,8 @@ DEALINGS IN THE SOFTWARE.
   * @note The need for this should be reviewed in the future, if a different memory allocator is
   * made available in the mbed platform.
   *
-  * TODO: Consider caching recently freed blocks to improve allocation time.
+  * Recently freed blocks may also be cached by size class to improve allocation time (see DEVICE_HEAP_CACHE),
+  * and the first fit walk may be replaced by segregated free lists (see DEVICE_HEAP_SEGREGATED).
   */
 
 #include "CodalConfig.h"
@@ -63,6 +64,10 @@ using namespace codal;
 HeapDefinition heap[DEVICE_MAXIMUM_HEAPS] = { };
 uint8_t heap_count = 0;
 
+// The number of calls to device_realloc() that resized a block in place, or moved it.
+static uint32_t realloc_in_place = 0;
+static uint32_t realloc_moved = 0;
+
 #if (CODAL_DEBUG >= CODAL_DEBUG_HEAP)
 // Diplays a usage summary about a given heap...
 void device_heap_print(HeapDefinition &heap)
@@ -80,7 +85,7 @@ void device_heap_print(HeapDefinition &heap)
 
     DMESG("heap_start : %p", heap.heap_start);
     DMESG("heap_end   : %p", heap.heap_end);
-    DMESG("heap_size  : %d", (int)heap.heap_end - (int)heap.heap_start);
+    DMESG("heap_size  : %d", (int)((uint8_t *)heap.heap_end - (uint8_t *)heap.heap_start));
 
     // Disable IRQ temporarily to ensure no race conditions!
     target_disable_irq();
@@ -88,7 +93,7 @@ void device_heap_print(HeapDefinition &heap)
     block = heap.heap_start;
     while (block < heap.heap_end)
     {
-        blockSize = *block & ~DEVICE_HEAP_BLOCK_FREE;
+        blockSize = *block & ~DEVICE_HEAP_BLOCK_FLAGS;
         if (*block & DEVICE_HEAP_BLOCK_FREE)
             DMESGN("[F:%d] ", blockSize*DEVICE_HEAP_BLOCK_SIZE);
         else
@@ -122,6 +127,242 @@ void device_heap_print()
 }
 #endif
 
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+#if DEVICE_HEAP_SEGREGATED_CLASSES < 1
+#error "DEVICE_HEAP_SEGREGATED_CLASSES must be at least 1"
+#endif
+
+// The smallest block the allocator creates: an index block, two links, and a copy of the size of the block once it is freed.
+#define DEVICE_HEAP_MIN_BLOCKS          4
+
+// The words of a free block that link it to its neighbours in the list of its size class...
+#define DEVICE_HEAP_LINK_NEXT           1
+#define DEVICE_HEAP_LINK_PREV           2
+
+// ... or in the tree of large free blocks.
+#define DEVICE_HEAP_LINK_LEFT           1
+#define DEVICE_HEAP_LINK_RIGHT          2
+#define DEVICE_HEAP_LINK_PARENT         3
+
+#define DEVICE_HEAP_LINK(block, link)   ((PROCESSOR_WORD_TYPE *)(block)[link])
+
+/**
+  * Determines the size class of a free block. Class c holds blocks of at least (DEVICE_HEAP_MIN_BLOCKS << c) blocks,
+  * and less than twice that.
+  *
+  * @param blocks The size of the free block, in blocks.
+  *
+  * @return The size class of the block, or DEVICE_HEAP_SEGREGATED_CLASSES if it belongs in the tree of large free blocks.
+  */
+static int device_heap_class(PROCESSOR_WORD_TYPE blocks)
+{
+    int c = 0;
+
+    while (c < DEVICE_HEAP_SEGREGATED_CLASSES && blocks >= ((PROCESSOR_WORD_TYPE)DEVICE_HEAP_MIN_BLOCKS << (c+1)))
+        c++;
+
+    return c;
+}
+
+/**
+  * Puts a given node of the tree of large free blocks in the place of another.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap that holds the tree.
+  * @param node The node to be replaced.
+  * @param child The node to put in its place, which may be NULL.
+  */
+static void device_heap_tree_replace(HeapDefinition &heap, PROCESSOR_WORD_TYPE *node, PROCESSOR_WORD_TYPE *child)
+{
+    PROCESSOR_WORD_TYPE *parent = DEVICE_HEAP_LINK(node, DEVICE_HEAP_LINK_PARENT);
+
+    if (parent == NULL)
+        heap.tree = child;
+    else if (DEVICE_HEAP_LINK(parent, DEVICE_HEAP_LINK_LEFT) == node)
+        parent[DEVICE_HEAP_LINK_LEFT] = (PROCESSOR_WORD_TYPE) child;
+    else
+        parent[DEVICE_HEAP_LINK_RIGHT] = (PROCESSOR_WORD_TYPE) child;
+
+    if (child)
+        child[DEVICE_HEAP_LINK_PARENT] = (PROCESSOR_WORD_TYPE) parent;
+}
+
+/**
+  * Adds a free block to the list of its size class, or to the tree of large free blocks.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap the block belongs to.
+  * @param block The index block of the free block.
+  */
+static void device_heap_insert(HeapDefinition &heap, PROCESSOR_WORD_TYPE *block)
+{
+    PROCESSOR_WORD_TYPE blockSize = *block & ~DEVICE_HEAP_BLOCK_FLAGS;
+    int c = device_heap_class(blockSize);
+
+    if (c < DEVICE_HEAP_SEGREGATED_CLASSES)
+    {
+        block[DEVICE_HEAP_LINK_NEXT] = (PROCESSOR_WORD_TYPE) heap.bins[c];
+        block[DEVICE_HEAP_LINK_PREV] = 0;
+
+        if (heap.bins[c])
+            heap.bins[c][DEVICE_HEAP_LINK_PREV] = (PROCESSOR_WORD_TYPE) block;
+
+        heap.bins[c] = block;
+        return;
+    }
+
+    // Large blocks are few, so the tree is not balanced. The new block simply becomes a leaf.
+    PROCESSOR_WORD_TYPE *parent = NULL;
+    PROCESSOR_WORD_TYPE *node = heap.tree;
+    int link = DEVICE_HEAP_LINK_LEFT;
+
+    while (node)
+    {
+        parent = node;
+        link = blockSize < (*node & ~DEVICE_HEAP_BLOCK_FLAGS) ? DEVICE_HEAP_LINK_LEFT : DEVICE_HEAP_LINK_RIGHT;
+        node = DEVICE_HEAP_LINK(node, link);
+    }
+
+    block[DEVICE_HEAP_LINK_LEFT] = 0;
+    block[DEVICE_HEAP_LINK_RIGHT] = 0;
+    block[DEVICE_HEAP_LINK_PARENT] = (PROCESSOR_WORD_TYPE) parent;
+
+    if (parent == NULL)
+        heap.tree = block;
+    else
+        parent[link] = (PROCESSOR_WORD_TYPE) block;
+}
+
+/**
+  * Removes a free block from the list of its size class, or from the tree of large free blocks.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap the block belongs to.
+  * @param block The index block of the free block.
+  */
+static void device_heap_remove(HeapDefinition &heap, PROCESSOR_WORD_TYPE *block)
+{
+    int c = device_heap_class(*block & ~DEVICE_HEAP_BLOCK_FLAGS);
+
+    if (c < DEVICE_HEAP_SEGREGATED_CLASSES)
+    {
+        PROCESSOR_WORD_TYPE *next = DEVICE_HEAP_LINK(block, DEVICE_HEAP_LINK_NEXT);
+        PROCESSOR_WORD_TYPE *prev = DEVICE_HEAP_LINK(block, DEVICE_HEAP_LINK_PREV);
+
+        if (next)
+            next[DEVICE_HEAP_LINK_PREV] = (PROCESSOR_WORD_TYPE) prev;
+
+        if (prev)
+            prev[DEVICE_HEAP_LINK_NEXT] = (PROCESSOR_WORD_TYPE) next;
+        else
+            heap.bins[c] = next;
+
+        return;
+    }
+
+    PROCESSOR_WORD_TYPE *left = DEVICE_HEAP_LINK(block, DEVICE_HEAP_LINK_LEFT);
+    PROCESSOR_WORD_TYPE *right = DEVICE_HEAP_LINK(block, DEVICE_HEAP_LINK_RIGHT);
+
+    if (left == NULL)
+    {
+        device_heap_tree_replace(heap, block, right);
+    }
+    else if (right == NULL)
+    {
+        device_heap_tree_replace(heap, block, left);
+    }
+    else
+    {
+        // The block has two children, so put the smallest block of its right subtree in its place.
+        PROCESSOR_WORD_TYPE *successor = right;
+
+        while (DEVICE_HEAP_LINK(successor, DEVICE_HEAP_LINK_LEFT))
+            successor = DEVICE_HEAP_LINK(successor, DEVICE_HEAP_LINK_LEFT);
+
+        if (successor != right)
+        {
+            device_heap_tree_replace(heap, successor, DEVICE_HEAP_LINK(successor, DEVICE_HEAP_LINK_RIGHT));
+            successor[DEVICE_HEAP_LINK_RIGHT] = (PROCESSOR_WORD_TYPE) right;
+            right[DEVICE_HEAP_LINK_PARENT] = (PROCESSOR_WORD_TYPE) successor;
+        }
+
+        device_heap_tree_replace(heap, block, successor);
+        successor[DEVICE_HEAP_LINK_LEFT] = (PROCESSOR_WORD_TYPE) left;
+        left[DEVICE_HEAP_LINK_PARENT] = (PROCESSOR_WORD_TYPE) successor;
+    }
+}
+
+/**
+  * Returns a block to a given heap, merging it with the free blocks either side of it, if any.
+  * Free blocks are merged as soon as they are freed, so there is never more than one on each side.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap the block belongs to.
+  * @param block The index block of the memory being freed.
+  */
+static void device_heap_release(HeapDefinition &heap, PROCESSOR_WORD_TYPE *block)
+{
+    PROCESSOR_WORD_TYPE blockSize = *block & ~DEVICE_HEAP_BLOCK_FLAGS;
+    PROCESSOR_WORD_TYPE *next = block + blockSize;
+
+    // A free block before this one keeps its size in its last word.
+    if (*block & DEVICE_HEAP_BLOCK_PREV_FREE)
+    {
+        PROCESSOR_WORD_TYPE prevSize = block[-1];
+
+        block -= prevSize;
+        blockSize += prevSize;
+        device_heap_remove(heap, block);
+    }
+
+    if (next < heap.heap_end && (*next & DEVICE_HEAP_BLOCK_FREE))
+    {
+        blockSize += *next & ~DEVICE_HEAP_BLOCK_FLAGS;
+        device_heap_remove(heap, next);
+    }
+
+    *block = blockSize | DEVICE_HEAP_BLOCK_FREE;
+    block[blockSize - 1] = blockSize;
+
+    next = block + blockSize;
+    if (next < heap.heap_end)
+        *next |= DEVICE_HEAP_BLOCK_PREV_FREE;
+
+    device_heap_insert(heap, block);
+}
+
+/**
+  * Marks the start of a block as used, returning any remainder large enough to be useful to the heap.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap the block belongs to.
+  * @param block The index block of a used block, or of a free block that has been removed from its size class.
+  * @param blocksNeeded The number of blocks required, including the index block.
+  */
+static void device_heap_use(HeapDefinition &heap, PROCESSOR_WORD_TYPE *block, PROCESSOR_WORD_TYPE blocksNeeded)
+{
+    PROCESSOR_WORD_TYPE blockSize = *block & ~DEVICE_HEAP_BLOCK_FLAGS;
+    PROCESSOR_WORD_TYPE prevFree = *block & DEVICE_HEAP_BLOCK_PREV_FREE;
+
+    if (blockSize >= blocksNeeded + DEVICE_HEAP_MIN_BLOCKS)
+    {
+        // We need to split the block.
+        *block = blocksNeeded | prevFree;
+        block[blocksNeeded] = blockSize - blocksNeeded;
+
+        device_heap_release(heap, block + blocksNeeded);
+    }
+    else
+    {
+        // Just mark the whole block as used.
+        *block = blockSize | prevFree;
+
+        if (block + blockSize < heap.heap_end)
+            block[blockSize] &= ~DEVICE_HEAP_BLOCK_PREV_FREE;
+    }
+}
+#endif
+
 /**
   * Create and initialise a given memory region as for heap storage.
   * After this is called, any future calls to malloc, new, free or delete may use the new heap.
@@ -159,9 +400,26 @@ int device_create_heap(PROCESSOR_WORD_TYPE start, PROCESSOR_WORD_TYPE end)
     // Record the dimensions of this new heap
     h->heap_start = (PROCESSOR_WORD_TYPE *)start;
     h->heap_end = (PROCESSOR_WORD_TYPE *)end;
+    h->used = 0;
+    h->peak = 0;
+    h->failed = 0;
+    memclr(h->allocations, sizeof(h->allocations));
+#if CONFIG_ENABLED(DEVICE_HEAP_CACHE)
+    memclr(h->cache, sizeof(h->cache));
+    memclr(h->cached, sizeof(h->cached));
+#endif
 
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+    memclr(h->bins, sizeof(h->bins));
+    h->tree = NULL;
+
+    // Initialise the heap as a single used block, and free it.
+    *h->heap_start = ((PROCESSOR_WORD_TYPE) h->heap_end - (PROCESSOR_WORD_TYPE) h->heap_start) / DEVICE_HEAP_BLOCK_SIZE;
+    device_heap_release(*h, h->heap_start);
+#else
     // Initialise the heap as being completely empty and available for use.
     *h->heap_start = DEVICE_HEAP_BLOCK_FREE | (((PROCESSOR_WORD_TYPE) h->heap_end - (PROCESSOR_WORD_TYPE) h->heap_start) / DEVICE_HEAP_BLOCK_SIZE);
+#endif
 
     heap_count++;
 
@@ -184,29 +442,267 @@ uint32_t device_heap_size(uint8_t heap_index)
 }
 
 /**
-  * Attempt to allocate a given amount of memory from a given heap area.
-  *
-  * @param size The amount of memory, in bytes, to allocate.
-  * @param heap The heap to allocate memory from.
-  *
-  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
-  */
-void *device_malloc_in(size_t size, HeapDefinition &heap)
+ * Reports the usage and fragmentation of a given heap.
+ *
+ * @param heap_index index between 0 and DEVICE_MAXIMUM_HEAPS-1
+ *
+ * @param stats The structure to fill in.
+ *
+ * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if no such heap exists or stats is NULL.
+ */
+int device_heap_stats(uint8_t heap_index, HeapStats *stats)
 {
-    PROCESSOR_WORD_TYPE	blockSize = 0;
-    PROCESSOR_WORD_TYPE	blocksNeeded = size % DEVICE_HEAP_BLOCK_SIZE == 0 ? size / DEVICE_HEAP_BLOCK_SIZE : size / DEVICE_HEAP_BLOCK_SIZE + 1;
+    PROCESSOR_WORD_TYPE	blockSize;
     PROCESSOR_WORD_TYPE	*block;
-    PROCESSOR_WORD_TYPE	*next;
+    PROCESSOR_WORD_TYPE	freeRun = 0;
 
-    if (size <= 0)
-        return NULL;
+    if (heap_index >= heap_count || stats == NULL)
+        return DEVICE_INVALID_PARAMETER;
 
-    // Account for the index block;
-    blocksNeeded++;
+    HeapDefinition *h = &heap[heap_index];
+
+    memclr(stats, sizeof(HeapStats));
 
     // Disable IRQ temporarily to ensure no race conditions!
     target_disable_irq();
 
+    // Adjacent free blocks are only merged as the heap is searched, so treat each run of them as a single region.
+    block = h->heap_start;
+    while (block < h->heap_end)
+    {
+        blockSize = *block & ~DEVICE_HEAP_BLOCK_FLAGS;
+
+        if (*block & DEVICE_HEAP_BLOCK_FREE)
+        {
+            if (freeRun == 0)
+                stats->freeBlocks++;
+
+            freeRun += blockSize;
+            stats->largestFreeBytes = max(stats->largestFreeBytes, (uint32_t)(freeRun * DEVICE_HEAP_BLOCK_SIZE));
+        }
+        else
+        {
+            stats->usedBlocks++;
+            freeRun = 0;
+        }
+
+        block += blockSize;
+    }
+
+#if CONFIG_ENABLED(DEVICE_HEAP_CACHE)
+    // Cached blocks are marked as used in the heap, but are available for allocation.
+    for (int c = 0; c < DEVICE_HEAP_CACHE_CLASSES; c++)
+    {
+        for (block = h->cache[c]; block; block = (PROCESSOR_WORD_TYPE *)block[1])
+        {
+            stats->cachedBytes += (*block & ~DEVICE_HEAP_BLOCK_FLAGS) * DEVICE_HEAP_BLOCK_SIZE;
+            stats->usedBlocks--;
+        }
+    }
+#endif
+
+    stats->usedBytes = h->used * DEVICE_HEAP_BLOCK_SIZE;
+    stats->peakBytes = h->peak * DEVICE_HEAP_BLOCK_SIZE;
+    stats->failed = h->failed;
+    memcpy(stats->allocations, h->allocations, sizeof(stats->allocations));
+
+    // Enable Interrupts
+    target_enable_irq();
+
+    stats->totalBytes = device_heap_size(heap_index);
+    stats->freeBytes = stats->totalBytes - stats->usedBytes;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Records a change in the amount of memory allocated from a given heap.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap that has changed.
+  * @param blocks The number of blocks allocated (if positive) or freed (if negative).
+  */
+static void device_heap_account(HeapDefinition &heap, int blocks)
+{
+    heap.used += blocks;
+
+    if (heap.used > heap.peak)
+        heap.peak = heap.used;
+}
+
+/**
+  * Records an allocation in the size class statistics of a given heap.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap allocated from.
+  * @param size The amount of memory requested, in bytes.
+  */
+static void device_heap_count(HeapDefinition &heap, size_t size)
+{
+    int sizeClass = 0;
+
+    while (sizeClass < DEVICE_HEAP_SIZE_CLASSES-1 && size > (size_t)(16 << sizeClass))
+        sizeClass++;
+
+    heap.allocations[sizeClass]++;
+}
+
+#if CONFIG_ENABLED(DEVICE_HEAP_CACHE)
+// The difference in size between successive cache classes, in bytes. Class c holds blocks of (c+1) granules.
+#define DEVICE_HEAP_CACHE_GRANULE       8
+
+/**
+  * Attempt to hold a freed block in the cache of its size class, rather than returning it to the heap.
+  * The block remains marked as used, and its first data word links it to the next block of the class.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap the block belongs to.
+  * @param block The index block of the memory being freed.
+  *
+  * @return 1 if the block was cached, 0 if it should be returned to the heap.
+  */
+static int device_heap_cache_push(HeapDefinition &heap, PROCESSOR_WORD_TYPE *block)
+{
+    // Find the largest class the block can serve.
+    int c = (int)(((*block & ~DEVICE_HEAP_BLOCK_FLAGS) - 1) * DEVICE_HEAP_BLOCK_SIZE / DEVICE_HEAP_CACHE_GRANULE) - 1;
+
+    if (c < 0 || c >= DEVICE_HEAP_CACHE_CLASSES || heap.cached[c] >= DEVICE_HEAP_CACHE_DEPTH)
+        return 0;
+
+    block[1] = (PROCESSOR_WORD_TYPE) heap.cache[c];
+    heap.cache[c] = block;
+    heap.cached[c]++;
+
+    return 1;
+}
+
+/**
+  * Takes the smallest block held in the size class caches of a given heap that can hold the given number of blocks.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap to take the block from.
+  * @param blocksNeeded The number of blocks required, including the index block.
+  *
+  * @return The index block of the cached block, or NULL if no cached block is large enough.
+  */
+static PROCESSOR_WORD_TYPE *device_heap_cache_pop(HeapDefinition &heap, PROCESSOR_WORD_TYPE blocksNeeded)
+{
+    for (int c = 0; c < DEVICE_HEAP_CACHE_CLASSES; c++)
+    {
+        PROCESSOR_WORD_TYPE *block = heap.cache[c];
+
+        if (block != NULL && (*block & ~DEVICE_HEAP_BLOCK_FLAGS) >= blocksNeeded)
+        {
+            heap.cache[c] = (PROCESSOR_WORD_TYPE *)block[1];
+            heap.cached[c]--;
+
+            return block;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+  * Returns every block held in the size class caches of a given heap to the heap itself.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap to flush.
+  *
+  * @return The number of blocks returned to the heap.
+  */
+static int device_heap_cache_flush(HeapDefinition &heap)
+{
+    int flushed = 0;
+
+    for (int c = 0; c < DEVICE_HEAP_CACHE_CLASSES; c++)
+    {
+        while (heap.cache[c])
+        {
+            PROCESSOR_WORD_TYPE *block = heap.cache[c];
+
+            heap.cache[c] = (PROCESSOR_WORD_TYPE *)block[1];
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+            device_heap_release(heap, block);
+#else
+            *block |= DEVICE_HEAP_BLOCK_FREE;
+#endif
+            flushed++;
+        }
+
+        heap.cached[c] = 0;
+    }
+
+    return flushed;
+}
+#endif
+
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+/**
+  * Finds a free block of a given heap large enough for the given number of blocks, and removes it from its size class.
+  * The first large enough block in the class of the request is used, otherwise the first block of the next non-empty
+  * class, otherwise the smallest large enough block in the tree. Must be called with interrupts disabled.
+  *
+  * @param heap The heap to search.
+  * @param blocksNeeded The number of blocks required, including the index block.
+  *
+  * @return The index block of the free block found, or NULL if there is none large enough.
+  */
+static PROCESSOR_WORD_TYPE *device_heap_find(HeapDefinition &heap, PROCESSOR_WORD_TYPE blocksNeeded)
+{
+    PROCESSOR_WORD_TYPE *block = NULL;
+    int c = device_heap_class(blocksNeeded);
+
+    if (c < DEVICE_HEAP_SEGREGATED_CLASSES)
+    {
+        for (block = heap.bins[c]; block; block = DEVICE_HEAP_LINK(block, DEVICE_HEAP_LINK_NEXT))
+            if ((*block & ~DEVICE_HEAP_BLOCK_FLAGS) >= blocksNeeded)
+                break;
+
+        // Every block of a larger class is large enough.
+        while (block == NULL && ++c < DEVICE_HEAP_SEGREGATED_CLASSES)
+            block = heap.bins[c];
+    }
+
+    if (block == NULL)
+    {
+        PROCESSOR_WORD_TYPE *node = heap.tree;
+
+        while (node)
+        {
+            if ((*node & ~DEVICE_HEAP_BLOCK_FLAGS) >= blocksNeeded)
+            {
+                block = node;
+                node = DEVICE_HEAP_LINK(node, DEVICE_HEAP_LINK_LEFT);
+            }
+            else
+            {
+                node = DEVICE_HEAP_LINK(node, DEVICE_HEAP_LINK_RIGHT);
+            }
+        }
+    }
+
+    if (block)
+        device_heap_remove(heap, block);
+
+    return block;
+}
+#else
+/**
+  * Finds the first free block of a given heap large enough for the given number of blocks, merging
+  * adjacent free blocks as it goes. Must be called with interrupts disabled.
+  *
+  * @param heap The heap to search.
+  * @param blocksNeeded The number of blocks required, including the index block.
+  *
+  * @return The index block of the free block found, or NULL if there is none large enough.
+  */
+static PROCESSOR_WORD_TYPE *device_heap_find(HeapDefinition &heap, PROCESSOR_WORD_TYPE blocksNeeded)
+{
+    PROCESSOR_WORD_TYPE	blockSize;
+    PROCESSOR_WORD_TYPE	*block;
+    PROCESSOR_WORD_TYPE	*next;
+
     // We implement a first fit algorithm with cache to handle rapid churn...
     // We also defragment free blocks as we search, to optimise this and future searches.
     block = heap.heap_start;
@@ -219,18 +715,15 @@ void *device_malloc_in(size_t size, HeapDefinition &heap)
             continue;
         }
 
-        blockSize = *block & ~DEVICE_HEAP_BLOCK_FREE;
+        blockSize = *block & ~DEVICE_HEAP_BLOCK_FLAGS;
 
         // We have a free block. Let's see if the subsequent ones are too. If so, we can merge...
         next = block + blockSize;
 
-        while (*next & DEVICE_HEAP_BLOCK_FREE)
+        while (next < heap.heap_end && (*next & DEVICE_HEAP_BLOCK_FREE))
         {
-            if (next >= heap.heap_end)
-                break;
-
             // We can merge!
-            blockSize += (*next & ~DEVICE_HEAP_BLOCK_FREE);
+            blockSize += (*next & ~DEVICE_HEAP_BLOCK_FLAGS);
             *block = blockSize | DEVICE_HEAP_BLOCK_FREE;
 
             next = block + blockSize;
@@ -239,19 +732,118 @@ void *device_malloc_in(size_t size, HeapDefinition &heap)
         // We have a free block. Let's see if it's big enough.
         // If so, we have a winner.
         if (blockSize >= blocksNeeded)
-            break;
+            return block;
 
         // Otherwise, keep looking...
         block += blockSize;
     }
 
+    return NULL;
+}
+#endif
+
+/**
+  * Attempt to allocate a given amount of memory from a given heap area.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  * @param heap The heap to allocate memory from.
+  *
+  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
+  */
+void *device_malloc_in(size_t size, HeapDefinition &heap)
+{
+    PROCESSOR_WORD_TYPE	blockSize = 0;
+    PROCESSOR_WORD_TYPE	blocksNeeded;
+    PROCESSOR_WORD_TYPE	*block;
+    size_t              bytesNeeded = size;
+
+    if (size <= 0)
+        return NULL;
+
+#if CONFIG_ENABLED(DEVICE_HEAP_CACHE)
+    int c = (int)((size + DEVICE_HEAP_CACHE_GRANULE - 1) / DEVICE_HEAP_CACHE_GRANULE) - 1;
+
+    if (c < DEVICE_HEAP_CACHE_CLASSES)
+    {
+        // Round up to the size of the class, so that the block can be reused for any allocation of its class once freed.
+        bytesNeeded = (c + 1) * DEVICE_HEAP_CACHE_GRANULE;
+
+        // Try the cache first. This is the only time interrupts are disabled on a hit.
+        target_disable_irq();
+
+        block = heap.cache[c];
+        if (block != NULL)
+        {
+            heap.cache[c] = (PROCESSOR_WORD_TYPE *)block[1];
+            heap.cached[c]--;
+
+            device_heap_account(heap, *block & ~DEVICE_HEAP_BLOCK_FLAGS);
+            device_heap_count(heap, size);
+        }
+
+        target_enable_irq();
+
+        if (block != NULL)
+            return block+1;
+    }
+#endif
+
+    blocksNeeded = bytesNeeded % DEVICE_HEAP_BLOCK_SIZE == 0 ? bytesNeeded / DEVICE_HEAP_BLOCK_SIZE : bytesNeeded / DEVICE_HEAP_BLOCK_SIZE + 1;
+
+    // Account for the index block;
+    blocksNeeded++;
+
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+    // Leave room for the links the block will hold once freed.
+    if (blocksNeeded < DEVICE_HEAP_MIN_BLOCKS)
+        blocksNeeded = DEVICE_HEAP_MIN_BLOCKS;
+#endif
+
+    // Disable IRQ temporarily to ensure no race conditions!
+    target_disable_irq();
+
+    block = device_heap_find(heap, blocksNeeded);
+
+#if CONFIG_ENABLED(DEVICE_HEAP_CACHE)
+    if (block == NULL)
+    {
+        // A cached block of a larger class can be used as it is...
+        block = device_heap_cache_pop(heap, blocksNeeded);
+
+        if (block != NULL)
+        {
+            device_heap_account(heap, *block & ~DEVICE_HEAP_BLOCK_FLAGS);
+            device_heap_count(heap, size);
+
+            target_enable_irq();
+            return block+1;
+        }
+
+        // ... otherwise return the cached blocks to the heap, where they can be merged with their neighbours, and search once more.
+        // Any pending interrupts are let in first, so that interrupts are never disabled for more than one search of the heap.
+        if (device_heap_cache_flush(heap))
+        {
+            target_enable_irq();
+            target_disable_irq();
+
+            block = device_heap_find(heap, blocksNeeded);
+        }
+    }
+#endif
+
     // We're full!
-    if (block >= heap.heap_end)
+    if (block == NULL)
     {
+        heap.failed++;
         target_enable_irq();
         return NULL;
     }
 
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+    device_heap_use(heap, block, blocksNeeded);
+#else
+    blockSize = *block & ~DEVICE_HEAP_BLOCK_FLAGS;
+
     // If we're at the end of memory or have very near match then mark the whole segment as in use.
     if (blockSize <= blocksNeeded+1 || block+blocksNeeded+1 >= heap.heap_end)
     {
@@ -267,6 +859,10 @@ void *device_malloc_in(size_t size, HeapDefinition &heap)
 
         *block = blocksNeeded;
     }
+#endif
+
+    device_heap_account(heap, *block & ~DEVICE_HEAP_BLOCK_FLAGS);
+    device_heap_count(heap, size);
 
     // Enable Interrupts
     target_enable_irq();
@@ -364,9 +960,36 @@ void device_free (void *mem)
         {
             // The memory block given is part of this heap, so we can simply
             // flag that this memory area is now free, and we're done.
-            if (*cb == 0 || *cb & DEVICE_HEAP_BLOCK_FREE)
+            if ((*cb & ~DEVICE_HEAP_BLOCK_FLAGS) == 0 || *cb & DEVICE_HEAP_BLOCK_FREE)
                 target_panic(DEVICE_HEAP_ERROR);
-            *cb |= DEVICE_HEAP_BLOCK_FREE;
+
+            target_disable_irq();
+            device_heap_account(heap[i], -(int)(*cb & ~DEVICE_HEAP_BLOCK_FLAGS));
+
+#if CONFIG_ENABLED(DEVICE_HEAP_CACHE)
+            if (device_heap_cache_push(heap[i], cb))
+            {
+                target_enable_irq();
+                return;
+            }
+#endif
+
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+            device_heap_release(heap[i], cb);
+#else
+            // Merge with any free blocks that directly follow, so that later searches have less to do.
+            PROCESSOR_WORD_TYPE blockSize = *cb;
+            PROCESSOR_WORD_TYPE *next = cb + blockSize;
+
+            while (next < heap[i].heap_end && (*next & DEVICE_HEAP_BLOCK_FREE))
+            {
+                blockSize += (*next & ~DEVICE_HEAP_BLOCK_FLAGS);
+                next = cb + blockSize;
+            }
+
+            *cb = blockSize | DEVICE_HEAP_BLOCK_FREE;
+#endif
+            target_enable_irq();
             return;
         }
     }
@@ -375,6 +998,7 @@ void device_free (void *mem)
     target_panic(DEVICE_HEAP_ERROR);
 }
 
+#if CONFIG_ENABLED(DEVICE_HEAP_REPLACE_LIBC)
 void* calloc (size_t num, size_t size)
 {
     void *mem = malloc(num*size);
@@ -388,26 +1012,155 @@ void* calloc (size_t num, size_t size)
 
     return mem;
 }
+#endif
+
+/**
+  * Attempt to resize a block of memory in place, by absorbing any free blocks immediately following it,
+  * or by splitting off its tail as a new free block.
+  *
+  * @param cb The index block of the memory to resize.
+  * @param blocksNeeded The number of blocks required, including the index block.
+  * @param heap The heap the memory was allocated from.
+  *
+  * @return 1 if the block now holds at least blocksNeeded blocks, 0 if it could not be resized in place.
+  */
+static int device_resize_in(PROCESSOR_WORD_TYPE *cb, PROCESSOR_WORD_TYPE blocksNeeded, HeapDefinition &heap)
+{
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+    PROCESSOR_WORD_TYPE oldSize = *cb & ~DEVICE_HEAP_BLOCK_FLAGS;
+    PROCESSOR_WORD_TYPE blockSize = oldSize;
+    PROCESSOR_WORD_TYPE *next = cb + blockSize;
+
+    // Free blocks are merged as they are freed, so at most one can follow the block.
+    if (next < heap.heap_end && (*next & DEVICE_HEAP_BLOCK_FREE))
+        blockSize += *next & ~DEVICE_HEAP_BLOCK_FLAGS;
+
+    if (blockSize < blocksNeeded)
+        return 0;
+
+    if (blockSize != oldSize)
+    {
+        device_heap_remove(heap, next);
+        *cb = blockSize | (*cb & DEVICE_HEAP_BLOCK_PREV_FREE);
+    }
+
+    device_heap_use(heap, cb, blocksNeeded);
+    device_heap_account(heap, (int)(*cb & ~DEVICE_HEAP_BLOCK_FLAGS) - (int)oldSize);
+#else
+    PROCESSOR_WORD_TYPE blockSize = *cb;
+    PROCESSOR_WORD_TYPE *next = cb + blockSize;
+
+    // Determine how much free space directly follows the block, without changing the heap.
+    while (blockSize < blocksNeeded && next < heap.heap_end && (*next & DEVICE_HEAP_BLOCK_FREE))
+    {
+        blockSize += (*next & ~DEVICE_HEAP_BLOCK_FLAGS);
+        next = cb + blockSize;
+    }
+
+    if (blockSize < blocksNeeded)
+        return 0;
+
+    PROCESSOR_WORD_TYPE oldSize = *cb;
+
+    // If the remainder is too small to be useful, just keep it as part of the block.
+    if (blockSize <= blocksNeeded+1)
+    {
+        *cb = blockSize;
+    }
+    else
+    {
+        // We need to split the block.
+        PROCESSOR_WORD_TYPE *splitBlock = cb + blocksNeeded;
+        *splitBlock = blockSize - blocksNeeded;
+        *splitBlock |= DEVICE_HEAP_BLOCK_FREE;
+
+        *cb = blocksNeeded;
+    }
+
+    device_heap_account(heap, (int)*cb - (int)oldSize);
+#endif
+
+    return 1;
+}
 
 extern "C" void* device_realloc (void* ptr, size_t size)
 {
-    void *mem = malloc(size);
+    PROCESSOR_WORD_TYPE	*memory = (PROCESSOR_WORD_TYPE *)ptr;
+    PROCESSOR_WORD_TYPE	*cb;
+    PROCESSOR_WORD_TYPE	blocksNeeded = size % DEVICE_HEAP_BLOCK_SIZE == 0 ? size / DEVICE_HEAP_BLOCK_SIZE : size / DEVICE_HEAP_BLOCK_SIZE + 1;
+    int i=0;
 
     // handle the simplest case - no previous memory allocted.
-    if (ptr != NULL && mem != NULL)
+    if (memory == NULL)
+        return device_malloc(size);
+
+    cb = memory-1;
+
+    // Account for the index block;
+    blocksNeeded++;
+
+#if CONFIG_ENABLED(DEVICE_HEAP_SEGREGATED)
+    if (blocksNeeded < DEVICE_HEAP_MIN_BLOCKS)
+        blocksNeeded = DEVICE_HEAP_MIN_BLOCKS;
+#endif
+
+    // Try to resize the block where it is, to save a copy.
+    if (size > 0)
     {
+#if (DEVICE_MAXIMUM_HEAPS > 1)
+        for (i=0; i < heap_count; i++)
+#endif
+        {
+            if(memory > heap[i].heap_start && memory < heap[i].heap_end)
+            {
+                // Disable IRQ temporarily to ensure no race conditions!
+                target_disable_irq();
 
-        // Otherwise we need to copy and free up the old data.
-        PROCESSOR_WORD_TYPE *cb = ((PROCESSOR_WORD_TYPE *)ptr) - 1;
-        PROCESSOR_WORD_TYPE blockSize = *cb & ~DEVICE_HEAP_BLOCK_FREE;
+                int resized = device_resize_in(cb, blocksNeeded, heap[i]);
 
-        memcpy(mem, ptr, min(blockSize * sizeof(PROCESSOR_WORD_TYPE), size));
-        free(ptr);
+                if (resized)
+                    realloc_in_place++;
+
+                target_enable_irq();
+
+                if (resized)
+                    return ptr;
+            }
+        }
+    }
+
+    void *mem = device_malloc(size);
+
+    if (mem != NULL)
+    {
+        // We need to copy and free up the old data.
+        PROCESSOR_WORD_TYPE blockSize = *cb & ~DEVICE_HEAP_BLOCK_FLAGS;
+
+        memcpy(mem, ptr, min((blockSize - 1) * sizeof(PROCESSOR_WORD_TYPE), size));
+        device_free(ptr);
+
+        realloc_moved++;
     }
 
     return mem;
 }
 
+/**
+  * Reports how many calls to device_realloc() resized a block in place, and how many had to move it.
+  *
+  * @param inPlace Set to the number of reallocations satisfied without moving the block. May be NULL.
+  * @param moved Set to the number of reallocations that copied the block to a new allocation. May be NULL.
+  */
+void device_realloc_stats(uint32_t *inPlace, uint32_t *moved)
+{
+    if (inPlace)
+        *inPlace = realloc_in_place;
+
+    if (moved)
+        *moved = realloc_moved;
+}
+
+#if CONFIG_ENABLED(DEVICE_HEAP_REPLACE_LIBC)
 void *malloc(size_t sz) __attribute__ ((weak, alias ("device_malloc")));
 void free(void *mem) __attribute__ ((weak, alias ("device_free")));
 void* realloc (void* ptr, size_t size) __attribute__ ((weak, alias ("device_realloc")));
@@ -423,5 +1176,6 @@ void _free_r(struct _reent *, void *addr)
 {
     free(addr);
 }
+#endif
 
 #endif
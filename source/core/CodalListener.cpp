@@ -55,6 +55,7 @@ Listener::Listener(uint16_t id, uint16_t value, void (*handler)(Event), uint16_t
     this->flags = flags;
 	this->next = NULL;
     this->evt_queue = NULL;
+    resetStatistics();
 }
 
 /**
@@ -83,6 +84,45 @@ Listener::Listener(uint16_t id, uint16_t value, void (*handler)(Event, void *),
     this->flags = flags | MESSAGE_BUS_LISTENER_PARAMETERISED;
 	this->next = NULL;
     this->evt_queue = NULL;
+    resetStatistics();
+}
+
+/**
+  * Constructor.
+  *
+  * Create a new Message Bus Listener, with a callback that receives events in batches.
+  *
+  * @param id The ID of the component you want to listen to.
+  *
+  * @param value The event value you would like to listen to from that component
+  *
+  * @param handler A function pointer to call with the matching events, and the number of them.
+  *
+  * @param flags User specified, implementation specific flags, that allow behaviour of this events listener
+  * to be tuned.
+  */
+Listener::Listener(uint16_t id, uint16_t value, void (*handler)(const Event *, int), uint16_t flags)
+{
+    this->id = id;
+    this->value = value;
+    this->cb_batch = handler;
+    this->cb_arg = NULL;
+    this->flags = flags | MESSAGE_BUS_LISTENER_BATCH;
+    this->next = NULL;
+    this->evt_queue = NULL;
+    resetStatistics();
+}
+
+/**
+  * Resets the dispatch statistics of this listener.
+  */
+void Listener::resetStatistics()
+{
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_STATISTICS)
+    this->invocations = 0;
+    this->blocks = 0;
+    this->run_time = 0;
+#endif
 }
 
 /**
@@ -105,7 +145,11 @@ void Listener::queue(Event e)
 
     EventQueueItem *p = evt_queue;
 
-    if (evt_queue == NULL)
+    // A listener interested only in the latest event holds at most one, replacing it as new events arrive.
+    if (evt_queue != NULL && (flags & MESSAGE_BUS_LISTENER_LATEST_ONLY))
+        evt_queue->evt = e;
+
+    else if (evt_queue == NULL)
         evt_queue = new EventQueueItem(e);
     else
     {
@@ -121,3 +165,23 @@ void Listener::queue(Event e)
             p->next = new EventQueueItem(e);
     }
 }
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_POOL)
+MemoryPool Listener::pool(sizeof(Listener), MESSAGE_BUS_LISTENER_POOL_SIZE);
+
+/**
+  * Allocates memory for a new instance from the pool.
+  */
+void *Listener::operator new(size_t size)
+{
+    return pool.allocate(size);
+}
+
+/**
+  * Returns the memory of an instance to the pool.
+  */
+void Listener::operator delete(void *p)
+{
+    pool.release(p);
+}
+#endif
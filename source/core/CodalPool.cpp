@@ -0,0 +1,183 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  * A pool of fixed size memory blocks, recycled through a free list.
+  */
+#include "CodalConfig.h"
+#include "CodalPool.h"
+#include "codal_target_hal.h"
+
+using namespace codal;
+
+// Blocks are aligned to the largest alignment of the types held, which may include 64 bit timestamps.
+#define MEMORY_POOL_ALIGNMENT       8
+
+/**
+  * Constructor. Creates a pool. No memory is allocated until the first block is requested.
+  *
+  * @param blockSize The size of each block, in bytes.
+  *
+  * @param blockCount The number of blocks in the arena.
+  */
+MemoryPool::MemoryPool(size_t blockSize, uint16_t blockCount)
+{
+    this->arena = NULL;
+    this->freeList = NULL;
+    this->blockSize = (blockSize + MEMORY_POOL_ALIGNMENT - 1) & ~(MEMORY_POOL_ALIGNMENT - 1);
+    this->blockCount = blockCount;
+    this->used = 0;
+    this->peak = 0;
+    this->overflows = 0;
+}
+
+/**
+  * Allocates a block from the pool, or from the heap if the pool is exhausted or the size requested
+  * is larger than the blocks of the pool.
+  *
+  * @param size The number of bytes required.
+  *
+  * @return A pointer to the memory allocated, or NULL if there is insufficient memory.
+  */
+void *MemoryPool::allocate(size_t size)
+{
+    void *block = NULL;
+
+    // A pool that has yet to be constructed (e.g. one used during static initialisation) has a blockSize of zero,
+    // so falls through to the heap.
+    if (size > blockSize)
+        return malloc(size);
+
+    if (arena == NULL)
+    {
+        uint8_t *memory = (uint8_t *) malloc(blockSize * blockCount);
+
+        if (memory != NULL)
+        {
+            target_disable_irq();
+
+            if (arena == NULL)
+            {
+                arena = memory;
+                memory = NULL;
+
+                for (int i = blockCount - 1; i >= 0; i--)
+                {
+                    void **b = (void **) (arena + i * blockSize);
+                    *b = freeList;
+                    freeList = b;
+                }
+            }
+
+            target_enable_irq();
+
+            free(memory);
+        }
+    }
+
+    target_disable_irq();
+
+    if (freeList != NULL)
+    {
+        block = freeList;
+        freeList = *(void **)block;
+
+        used++;
+        if (used > peak)
+            peak = used;
+    }
+    else
+    {
+        overflows++;
+    }
+
+    target_enable_irq();
+
+    if (block == NULL)
+        block = malloc(size);
+
+    return block;
+}
+
+/**
+  * Releases a block previously returned by allocate().
+  *
+  * @param block The block to release. May be NULL.
+  */
+void MemoryPool::release(void *block)
+{
+    if (contains(block))
+    {
+        target_disable_irq();
+
+        *(void **)block = freeList;
+        freeList = block;
+        used--;
+
+        target_enable_irq();
+    }
+    else
+    {
+        free(block);
+    }
+}
+
+/**
+  * Determines if a block was allocated from the arena of this pool, rather than from the heap.
+  *
+  * @param block The block to inspect.
+  *
+  * @return true if the block lies within the arena of this pool, false otherwise.
+  */
+bool MemoryPool::contains(void *block)
+{
+    uint8_t *b = (uint8_t *) block;
+
+    return arena != NULL && b >= arena && b < arena + blockSize * blockCount;
+}
+
+/**
+  * Determines the number of blocks of the arena currently allocated.
+  */
+int MemoryPool::getUsed()
+{
+    return used;
+}
+
+/**
+  * Determines the largest number of blocks of the arena that have been allocated at once.
+  */
+int MemoryPool::getPeak()
+{
+    return peak;
+}
+
+/**
+  * Determines the number of allocations that were made from the heap as the arena was full.
+  */
+uint32_t MemoryPool::getOverflowCount()
+{
+    return overflows;
+}
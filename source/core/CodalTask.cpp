@@ -0,0 +1,508 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Lightweight, stackless tasks.
+  *
+  * Runnable tasks are held on a FIFO queue, and run in turn by a single task runner fiber. Between
+  * each pass over the queue, the runner yields to the fiber scheduler, so that tasks that yield
+  * repeatedly cannot starve other fibers. Once no tasks are runnable, the runner blocks until one is.
+  *
+  * Sleeping tasks are held in order of wake up time, with a single system timer event armed for the
+  * earliest of them. Tasks blocked on events are woken through the EventModel, as fibers are.
+  */
+#include "CodalConfig.h"
+#include "CodalTask.h"
+#include "CodalFiber.h"
+#include "CodalComponent.h"
+#include "EventModel.h"
+#include "NotifyEvents.h"
+#include "ErrorNo.h"
+#include "Timer.h"
+#include "codal_target_hal.h"
+
+namespace codal
+{
+static Task *readyQueue = NULL;                    // The list of runnable tasks, in the order in which they will be run.
+static Task *readyQueueTail = NULL;                // The last task on the readyQueue.
+static uint32_t readyCount = 0;                    // The number of tasks on the readyQueue.
+static Task *sleepQueue = NULL;                    // The list of sleeping tasks, in order of wake up time.
+static Task *waitQueue = NULL;                     // The list of tasks blocked on an event.
+static Task *currentTask = NULL;                   // The task currently being run, if any.
+static Fiber *taskRunner = NULL;                   // The fiber that runs all tasks.
+static uint8_t runnerWaiting = 0;                  // Set when the task runner is blocked waiting for runnable tasks.
+}
+
+using namespace codal;
+
+/**
+  * Removes the given task from the given singly linked queue.
+  *
+  * @param t The task to remove.
+  *
+  * @param queue The queue to remove the task from.
+  *
+  * @return The task that preceded t on the queue, or NULL if t was at the head of the queue or not present.
+  */
+static Task *dequeue_task(Task *t, Task **queue)
+{
+    Task *prev = NULL;
+
+    for (Task **p = queue; *p != NULL; prev = *p, p = &(*p)->next)
+    {
+        if (*p == t)
+        {
+            *p = t->next;
+            t->next = NULL;
+            break;
+        }
+    }
+
+    return prev;
+}
+
+/**
+  * Adds the given task to the tail of the ready queue.
+  *
+  * @param t The task to make runnable.
+  *
+  * @return 1 if the task runner is blocked, and must be woken through wake_runner(), 0 otherwise.
+  */
+static int ready_task(Task *t)
+{
+    int wake = 0;
+
+    target_disable_irq();
+
+    t->state = DEVICE_TASK_STATE_READY;
+    t->next = NULL;
+
+    if (readyQueueTail)
+        readyQueueTail->next = t;
+    else
+        readyQueue = t;
+
+    readyQueueTail = t;
+    readyCount++;
+
+    if (runnerWaiting)
+    {
+        runnerWaiting = 0;
+        wake = 1;
+    }
+
+    target_enable_irq();
+
+    return wake;
+}
+
+/**
+  * Wakes the task runner. This raises an event, so is only called once any queue being walked has been updated.
+  */
+static void wake_runner()
+{
+    Event(DEVICE_ID_NOTIFY, CODAL_TASK_EVT_READY);
+}
+
+/**
+  * Removes the task at the head of the ready queue.
+  *
+  * @return The task removed, or NULL if the ready queue is empty.
+  */
+static Task *next_ready_task()
+{
+    target_disable_irq();
+
+    Task *t = readyQueue;
+
+    if (t)
+    {
+        readyQueue = t->next;
+        t->next = NULL;
+        readyCount--;
+
+        if (readyQueue == NULL)
+            readyQueueTail = NULL;
+    }
+
+    target_enable_irq();
+
+    return t;
+}
+
+/**
+  * Arms a single timer event for the wake up time of the task at the head of the sleep queue,
+  * replacing any previously armed wake up.
+  */
+static void task_arm_wakeup()
+{
+    target_disable_irq();
+
+    system_timer_cancel_event(DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_TASK);
+
+    if (sleepQueue != NULL)
+    {
+        CODAL_TIMESTAMP now = system_timer_current_time();
+        CODAL_TIMESTAMP period = sleepQueue->context > now ? sleepQueue->context - now : 0;
+
+        system_timer_event_after_us(period * 1000, DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_TASK);
+    }
+
+    target_enable_irq();
+}
+
+/**
+  * The timer callback, called once the earliest sleeping task is due.
+  * Wakes up any sleeping tasks that are due, and arms the wake up of the next.
+  */
+static void task_tick(Event evt)
+{
+#if !CONFIG_ENABLED(LIGHTWEIGHT_EVENTS)
+    evt.timestamp /= 1000;
+#endif
+
+    int wake = 0;
+
+    while (sleepQueue != NULL && evt.timestamp >= sleepQueue->context)
+    {
+        target_disable_irq();
+        Task *t = sleepQueue;
+        sleepQueue = t->next;
+        target_enable_irq();
+
+        wake |= ready_task(t);
+    }
+
+    task_arm_wakeup();
+
+    if (wake)
+        wake_runner();
+}
+
+/**
+  * Event callback. Wakes up any tasks blocked on the given event.
+  *
+  * @param evt the event that has just been raised.
+  */
+static void task_event(Event evt)
+{
+    Task **p = &waitQueue;
+    int wake = 0;
+
+    while (*p != NULL)
+    {
+        Task *t = *p;
+
+        // extract the event data this task is blocked on.
+        uint16_t id = t->context & 0xFFFF;
+        uint16_t value = (t->context & 0xFFFF0000) >> 16;
+
+        // Tasks waiting on the NOTIFY channel are woken by NOTIFY_ONE events only through task_notify_one().
+        if ((id == DEVICE_ID_ANY || id == evt.source) && (value == DEVICE_EVT_ANY || value == evt.value))
+        {
+            *p = t->next;
+            wake |= ready_task(t);
+            continue;
+        }
+
+        p = &t->next;
+    }
+
+    if (wake)
+        wake_runner();
+
+#if !CONFIG_ENABLED(SCHEDULER_LISTEN_ALL_EVENTS)
+    // Unregister this event, as we've woken up all the tasks with this match.
+    if (evt.source != DEVICE_ID_NOTIFY && evt.source != DEVICE_ID_NOTIFY_ONE && EventModel::defaultEventBus)
+        EventModel::defaultEventBus->ignore(evt.source, evt.value, task_event);
+#endif
+}
+
+/**
+  * NOTIFY_ONE callback, called by the fiber scheduler only if no fiber was waiting to be notified.
+  * Wakes up the task that has waited longest on the equivalent NOTIFY event, if any.
+  *
+  * @param evt the NOTIFY_ONE event that has just been raised.
+  */
+static void task_notify_one(Event evt)
+{
+    Task **notifyOne = NULL;
+
+    // Tasks are queued at the head, so the last match has waited the longest.
+    for (Task **p = &waitQueue; *p != NULL; p = &(*p)->next)
+    {
+        uint16_t id = (*p)->context & 0xFFFF;
+        uint16_t value = ((*p)->context & 0xFFFF0000) >> 16;
+
+        if (id == DEVICE_ID_NOTIFY && (value == DEVICE_EVT_ANY || value == evt.value))
+            notifyOne = p;
+    }
+
+    if (notifyOne)
+    {
+        Task *t = *notifyOne;
+        *notifyOne = t->next;
+
+        if (ready_task(t))
+            wake_runner();
+    }
+}
+
+/**
+  * The task runner. Runs all runnable tasks, yielding to other fibers after each pass over the ready queue.
+  */
+static void task_runner()
+{
+    while (1)
+    {
+        // Run only those tasks that were runnable at the start of this pass.
+        uint32_t count = readyCount;
+
+        while (count--)
+        {
+            Task *t = next_ready_task();
+
+            if (t == NULL)
+                break;
+
+            currentTask = t;
+            int result = t->fn(t);
+            currentTask = NULL;
+
+            // The state of the task is changed by any blocking operation, or if the task stopped itself.
+            if (t->state != DEVICE_TASK_STATE_READY)
+                continue;
+
+            if (result == DEVICE_TASK_YIELDED)
+                ready_task(t);
+            else if (result == DEVICE_TASK_EXITED)
+                t->state = DEVICE_TASK_STATE_IDLE;
+        }
+
+        if (readyQueue)
+        {
+            schedule();
+            continue;
+        }
+
+        // Block until a task becomes runnable. We start waiting before checking the ready queue once more,
+        // so that a task made runnable in the meantime is never missed.
+        fiber_wake_on_event(DEVICE_ID_NOTIFY, CODAL_TASK_EVT_READY);
+        runnerWaiting = 1;
+
+        if (readyQueue)
+        {
+            runnerWaiting = 0;
+            wake_runner();
+        }
+
+        schedule();
+    }
+}
+
+/**
+  * Starts the given task. The task function is called from the task runner fiber, starting from TASK_BEGIN.
+  *
+  * @param t The task to start. The task must remain valid until it exits, or is stopped.
+  *
+  * @param fn The task function.
+  *
+  * @return DEVICE_OK, DEVICE_INVALID_PARAMETER if a parameter is NULL, DEVICE_BUSY if the task is already running,
+  *         DEVICE_NOT_SUPPORTED if the fiber scheduler is not running, or DEVICE_NO_RESOURCES if the task runner could not be created.
+  */
+int codal::task_start(Task *t, int (*fn)(Task *))
+{
+    if (t == NULL || fn == NULL)
+        return DEVICE_INVALID_PARAMETER;
+
+    if (task_running(t))
+        return DEVICE_BUSY;
+
+    if (!fiber_scheduler_running() || EventModel::defaultEventBus == NULL)
+        return DEVICE_NOT_SUPPORTED;
+
+    if (taskRunner == NULL)
+    {
+        taskRunner = create_fiber(task_runner);
+
+        if (taskRunner == NULL)
+            return DEVICE_NO_RESOURCES;
+
+#if CONFIG_ENABLED(SCHEDULER_LISTEN_ALL_EVENTS)
+        // We register once to receive all events, as the scheduler does, so that waiting tasks need no listener of their own.
+        EventModel::defaultEventBus->listen(DEVICE_ID_ANY, DEVICE_EVT_ANY, task_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+#else
+        // We always stay registered for the notify channels, as fibers do.
+        EventModel::defaultEventBus->listen(DEVICE_ID_NOTIFY, DEVICE_EVT_ANY, task_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+        EventModel::defaultEventBus->listen(DEVICE_ID_NOTIFY_ONE, DEVICE_EVT_ANY, task_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+#endif
+        // Only one waiter is woken by each NOTIFY_ONE event, so the scheduler decides whether it is a fiber or a task.
+        scheduler_set_notify_one_handler(task_notify_one);
+        EventModel::defaultEventBus->listen(DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_TASK, task_tick, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    }
+
+    t->fn = fn;
+    t->lc = 0;
+
+    if (ready_task(t))
+        wake_runner();
+
+    return DEVICE_OK;
+}
+
+/**
+  * Stops the given task, without running it any further. The task may then be started again.
+  *
+  * @param t The task to stop.
+  *
+  * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if t is NULL.
+  */
+int codal::task_stop(Task *t)
+{
+    if (t == NULL)
+        return DEVICE_INVALID_PARAMETER;
+
+    target_disable_irq();
+
+    if (t->state == DEVICE_TASK_STATE_READY && t != currentTask)
+    {
+        Task *prev = dequeue_task(t, &readyQueue);
+
+        if (readyQueueTail == t)
+            readyQueueTail = prev;
+
+        readyCount--;
+    }
+
+    if (t->state == DEVICE_TASK_STATE_SLEEPING)
+    {
+        int head = sleepQueue == t;
+
+        dequeue_task(t, &sleepQueue);
+
+        if (head)
+            task_arm_wakeup();
+    }
+
+    if (t->state == DEVICE_TASK_STATE_WAITING)
+        dequeue_task(t, &waitQueue);
+
+    t->state = DEVICE_TASK_STATE_IDLE;
+    t->lc = 0;
+
+    target_enable_irq();
+
+    return DEVICE_OK;
+}
+
+/**
+  * Determines if the given task has been started, and has not yet exited.
+  *
+  * @param t The task to inspect.
+  *
+  * @return 1 if the task is running, 0 otherwise.
+  */
+int codal::task_running(Task *t)
+{
+    return t != NULL && t->state != DEVICE_TASK_STATE_IDLE;
+}
+
+/**
+  * Configures the given task to sleep for the given period of time. Normally used through TASK_SLEEP().
+  *
+  * @param t The task to configure. This must be the task currently being run.
+  *
+  * @param ms The period of time to sleep, in milliseconds.
+  *
+  * @return DEVICE_OK, or DEVICE_INVALID_PARAMETER if t is not being run.
+  */
+int codal::task_sleep(Task *t, unsigned long ms)
+{
+    if (t == NULL || t != currentTask)
+        return DEVICE_INVALID_PARAMETER;
+
+    t->context = system_timer_current_time() + ms;
+    t->state = DEVICE_TASK_STATE_SLEEPING;
+
+    target_disable_irq();
+
+    // Find the first task that is due strictly after this one.
+    Task **p = &sleepQueue;
+
+    while (*p != NULL && (*p)->context <= t->context)
+        p = &(*p)->next;
+
+    t->next = *p;
+    *p = t;
+
+    target_enable_irq();
+
+    // If we're now the first task due to wake, bring the wake up forward.
+    if (sleepQueue == t)
+        task_arm_wakeup();
+
+    return DEVICE_OK;
+}
+
+/**
+  * Configures the given task to block until the specified event is raised. Normally used through TASK_WAIT_FOR_EVENT().
+  *
+  * @param t The task to configure. This must be the task currently being run.
+  *
+  * @param id The ID field of the event to listen for (e.g. DEVICE_ID_BUTTON_A)
+  *
+  * @param value The value of the event to listen for (e.g. DEVICE_BUTTON_EVT_CLICK)
+  *
+  * @return DEVICE_OK, DEVICE_INVALID_PARAMETER if t is not being run, or DEVICE_NOT_SUPPORTED if there is no EventModel.
+  */
+int codal::task_wait_for_event(Task *t, uint16_t id, uint16_t value)
+{
+    if (t == NULL || t != currentTask)
+        return DEVICE_INVALID_PARAMETER;
+
+    if (EventModel::defaultEventBus == NULL)
+        return DEVICE_NOT_SUPPORTED;
+
+    // Encode the event data in the context field, as fibers do.
+    t->context = (uint32_t)value << 16 | id;
+    t->state = DEVICE_TASK_STATE_WAITING;
+
+    target_disable_irq();
+    t->next = waitQueue;
+    waitQueue = t;
+    target_enable_irq();
+
+#if CONFIG_ENABLED(SCHEDULER_LISTEN_ALL_EVENTS)
+    // task_event() receives every event, so there is nothing to register. Announce the wait as registering would have.
+    if (id != DEVICE_ID_NOTIFY && id != DEVICE_ID_NOTIFY_ONE)
+        Event(DEVICE_ID_MESSAGE_BUS_LISTENER, id);
+#else
+    // Register to receive this event, so we can wake up the task when it happens.
+    // Special case for the notify channel, as we always stay registered for that.
+    if (id != DEVICE_ID_NOTIFY && id != DEVICE_ID_NOTIFY_ONE)
+        EventModel::defaultEventBus->listen(id, value, task_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+#endif
+
+    return DEVICE_OK;
+}
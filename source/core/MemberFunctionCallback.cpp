@@ -57,3 +57,23 @@ bool MemberFunctionCallback::operator==(const MemberFunctionCallback &mfc)
 {
     return (object == mfc.object && (memcmp(method,mfc.method,sizeof(method))==0));
 }
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_POOL)
+MemoryPool MemberFunctionCallback::pool(sizeof(MemberFunctionCallback), MESSAGE_BUS_LISTENER_POOL_SIZE);
+
+/**
+  * Allocates memory for a new instance from the pool.
+  */
+void *MemberFunctionCallback::operator new(size_t size)
+{
+    return pool.allocate(size);
+}
+
+/**
+  * Returns the memory of an instance to the pool.
+  */
+void MemberFunctionCallback::operator delete(void *p)
+{
+    pool.release(p);
+}
+#endif
@@ -64,6 +64,7 @@ Accelerometer::Accelerometer(CoordinateSpace &cspace, uint16_t id) : sample(), s
     this->shake.impulse_3 = 1;
     this->shake.impulse_6 = 1;
     this->shake.impulse_8 = 1;
+    this->sampleChannel = NULL;
 }
 
 /**
@@ -92,6 +93,17 @@ int Accelerometer::update()
     // Indicate that a new sample is available
     Event e(id, ACCELEROMETER_EVT_DATA_UPDATE);
 
+    if (sampleChannel)
+    {
+        Sample3D *s = sampleChannel->acquire();
+
+        if (s)
+        {
+            *s = sample;
+            sampleChannel->publish(s);
+        }
+    }
+
     return DEVICE_OK;
 };
 
@@ -389,6 +401,18 @@ int Accelerometer::requestUpdate()
     return DEVICE_NOT_SUPPORTED;
 }
 
+/**
+ * Configures a channel on which each new sample is published, in the coordinate system defined in the constructor.
+ * Subscribers to the channel receive every sample, rather than reading the latest through getSample()
+ * when notified by ACCELEROMETER_EVT_DATA_UPDATE. Samples are dropped whilst the pool of the channel is exhausted.
+ *
+ * @param channel The channel to publish samples on, or NULL to stop publishing.
+ */
+void Accelerometer::setSampleChannel(Channel<Sample3D> *channel)
+{
+    sampleChannel = channel;
+}
+
 /**
  * Reads the last accelerometer value stored, and provides it in the coordinate system requested.
  *
@@ -402,7 +402,7 @@ void Serial::printf(const char* format, ...)
         char current = *end++;
         if (current == '%')
         {
-            uint32_t val = va_arg(arg, uint32_t);
+            PROCESSOR_WORD_TYPE val = va_arg(arg, PROCESSOR_WORD_TYPE);
             char* str = (char *)((void *)val);
             char* buffPtr = buff;
             char c = 0;
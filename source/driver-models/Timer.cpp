@@ -40,6 +40,7 @@ DEALINGS IN THE SOFTWARE.
 #include "ErrorNo.h"
 #include "codal_target_hal.h"
 #include "CodalDmesg.h"
+#include "CodalFiber.h"
 
 using namespace codal;
 
@@ -60,33 +61,113 @@ void timer_callback(uint16_t chan)
     }
 }
 
+/**
+ * Determines the range of the underlying counter, assuming at least a 16 bit counter.
+ *
+ * @return a mask of the bits of the counter that sync() can rely on.
+ */
+uint32_t Timer::counterMask()
+{
+    TimerBitMode mode = timer.getBitMode();
+
+    if (mode == BitMode32)
+        return 0xffffffff;
+
+    if (mode == BitMode24)
+        return 0x00ffffff;
+
+    return 0x0000ffff;
+}
+
 void Timer::triggerIn(CODAL_TIMESTAMP t)
 {
+    // Wake up at least twice per counter period, so sync() never misses an overflow
+    // (e.g. when there is no periodic scheduler tick).
+    uint32_t limit = counterMask() >> 1;
+
     if (t < CODAL_TIMER_MINIMUM_PERIOD) t = CODAL_TIMER_MINIMUM_PERIOD;
+    if (t > limit) t = limit;
     // Just in case, disable all IRQs
     target_disable_irq();
     timer.setCompare(this->ccEventChannel, timer.captureCounter() + t);
     target_enable_irq();
 }
 
-TimerEvent *Timer::getTimerEvent()
+/**
+ * Moves the event at the given position of the heap towards the root, until it is no earlier than its parent.
+ *
+ * @param i The index of the event in timerEventList.
+ *
+ * @return The new index of the event.
+ */
+int Timer::siftUp(int i)
+{
+    TimerEvent e = timerEventList[i];
+
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+
+        if (timerEventList[parent].timestamp <= e.timestamp)
+            break;
+
+        timerEventList[i] = timerEventList[parent];
+        i = parent;
+    }
+
+    timerEventList[i] = e;
+
+    return i;
+}
+
+/**
+ * Moves the event at the given position of the heap towards the leaves, until it is no later than its children.
+ *
+ * @param i The index of the event in timerEventList.
+ */
+void Timer::siftDown(int i)
 {
-    // Find the first unused slot, and assign it.
-    for (int i=0; i < eventListSize; i++)
+    TimerEvent e = timerEventList[i];
+
+    while (1)
     {
-        if (timerEventList[i].id == 0)
-            return &timerEventList[i];
+        int child = 2 * i + 1;
+
+        if (child >= eventCount)
+            break;
+
+        if (child + 1 < eventCount && timerEventList[child + 1].timestamp < timerEventList[child].timestamp)
+            child++;
+
+        if (e.timestamp <= timerEventList[child].timestamp)
+            break;
+
+        timerEventList[i] = timerEventList[child];
+        i = child;
     }
 
-    // TODO: should try to realloc the list here.
-    return NULL;
+    timerEventList[i] = e;
 }
 
-void Timer::releaseTimerEvent(TimerEvent *event)
+/**
+ * Removes the event at the given position of the heap.
+ *
+ * @param i The index of the event in timerEventList.
+ */
+void Timer::removeTimerEvent(int i)
 {
-    event->id = 0;
-    if (nextTimerEvent == event)
-        nextTimerEvent = NULL;
+    eventCount--;
+
+    if (i == eventCount)
+        return;
+
+    // Fill the hole with the last event, which may belong either above or below it.
+    timerEventList[i] = timerEventList[eventCount];
+
+    if (i > 0 && timerEventList[i].timestamp < timerEventList[(i - 1) / 2].timestamp)
+        siftUp(i);
+    else
+        siftDown(i);
 }
 
 /**
@@ -104,7 +185,8 @@ Timer::Timer(LowLevelTimer& t, uint8_t ccPeriodChannel, uint8_t ccEventChannel)
     eventListSize = CODAL_TIMER_DEFAULT_EVENT_LIST_SIZE;
     timerEventList = (TimerEvent *) malloc(sizeof(TimerEvent) * CODAL_TIMER_DEFAULT_EVENT_LIST_SIZE);
     memclr(timerEventList, sizeof(TimerEvent) * CODAL_TIMER_DEFAULT_EVENT_LIST_SIZE);
-    nextTimerEvent = NULL;
+    eventCount = 0;
+    growPending = false;
 
     // Reset clock
     currentTime = 0;
@@ -156,22 +238,61 @@ int Timer::enableInterrupts()
     return DEVICE_OK;
 }
 
-int Timer::setEvent(CODAL_TIMESTAMP period, uint16_t id, uint16_t value, bool repeat)
+/**
+ * Doubles the number of events the event list can hold.
+ * This allocates memory, so is deferred to thread context by setEvent(), which may be called from an interrupt.
+ *
+ * @param t The Timer whose event list should be grown.
+ */
+void Timer::growEventList(void *t)
 {
-    TimerEvent *evt = getTimerEvent();
-    if (evt == NULL)
-        return DEVICE_NO_RESOURCES;
+    Timer *timer = (Timer *)t;
+    TimerEvent *list = (TimerEvent *) malloc(sizeof(TimerEvent) * timer->eventListSize * 2);
+
+    target_disable_irq();
 
-    evt->set(getTimeUs() + period, repeat ? period: 0, id, value);
+    // Only this function changes the size of the list, so the list can simply be moved across.
+    if (list != NULL)
+    {
+        TimerEvent *old = timer->timerEventList;
+
+        memcpy(list, old, sizeof(TimerEvent) * timer->eventCount);
+        timer->timerEventList = list;
+        timer->eventListSize *= 2;
+        list = old;
+    }
+
+    timer->growPending = false;
+
+    target_enable_irq();
+
+    free(list);
+}
+
+int Timer::setEvent(CODAL_TIMESTAMP period, uint16_t id, uint16_t value, bool repeat)
+{
+    CODAL_TIMESTAMP timestamp = getTimeUs() + period;
 
     target_disable_irq();
 
-    if (nextTimerEvent == NULL || evt->timestamp < nextTimerEvent->timestamp)
+    // This may be called from interrupt context (e.g. by handlers that rearm themselves), so never allocate memory here.
+    if (eventCount == eventListSize)
     {
-        nextTimerEvent = evt;
-        triggerIn(period);
+        target_enable_irq();
+        return DEVICE_NO_RESOURCES;
     }
 
+    timerEventList[eventCount].set(timestamp, repeat ? period: 0, id, value);
+    eventCount++;
+
+    // Reschedule if the new event is now the earliest.
+    if (siftUp(eventCount - 1) == 0)
+        triggerIn(period);
+
+    // Once the list is three quarters full, grow it in thread context, ahead of the need for more space.
+    if (!growPending && eventCount * 4 >= eventListSize * 3)
+        growPending = fiber_defer(&Timer::growEventList, this) == DEVICE_OK;
+
     target_enable_irq();
 
     return DEVICE_OK;
@@ -190,22 +311,20 @@ int Timer::cancel(uint16_t id, uint16_t value)
     int res = DEVICE_INVALID_PARAMETER;
 
     target_disable_irq();
-    if (nextTimerEvent && nextTimerEvent->id == id && nextTimerEvent->value == value)
+    for (int i=0; i<eventCount; i++)
     {
-        nextTimerEvent->id = 0;
-        recomputeNextTimerEvent();
-        res = DEVICE_OK;
-    }
-    else
-        for (int i=0; i<eventListSize; i++)
+        if (timerEventList[i].id == id && timerEventList[i].value == value)
         {
-            if (timerEventList[i].id == id && timerEventList[i].value == value)
-            {
-                timerEventList[i].id = 0;
-                res = DEVICE_OK;
-                break;
-            }
+            removeTimerEvent(i);
+
+            // Only the earliest event has been scheduled with the low level timer.
+            if (i == 0)
+                recomputeNextTimerEvent();
+
+            res = DEVICE_OK;
+            break;
         }
+    }
     target_enable_irq();
 
     return res;
@@ -284,8 +403,8 @@ void Timer::sync()
     uint32_t val = timer.captureCounter();
     uint32_t elapsed = 0;
 
-    // assume at least 16 bit counter; note that this also works when the timer overflows
-    elapsed = (uint16_t)(val - sigma);
+    // note that this also works when the timer overflows, provided we are called at least once per counter period
+    elapsed = (val - sigma) & counterMask();
     sigma = val;
 
     // advance main timer
@@ -304,22 +423,12 @@ void Timer::sync()
 
 void Timer::recomputeNextTimerEvent()
 {
-    nextTimerEvent = NULL;
-
-    TimerEvent *e = timerEventList;
-
-    // Find the next most recent and schedule it.
-    for (int i = 0; i < eventListSize; i++)
-    {
-        if (e->id != 0 && (nextTimerEvent == NULL || (e->timestamp < nextTimerEvent->timestamp)))
-            nextTimerEvent = e;
-        e++;
-    }
-
-    if (nextTimerEvent) {
+    // The earliest event is always at the root of the heap.
+    if (eventCount > 0) {
         // this may possibly happen if a new timer event was added to the queue while
         // we were running - it might be already in the past
-        triggerIn(max(nextTimerEvent->timestamp - currentTimeUs, CODAL_TIMER_MINIMUM_PERIOD));
+        CODAL_TIMESTAMP t = timerEventList[0].timestamp;
+        triggerIn(t > currentTimeUs ? t - currentTimeUs : CODAL_TIMER_MINIMUM_PERIOD);
     }
 }
 
@@ -331,45 +440,36 @@ void Timer::trigger(bool isFallback)
     if (isFallback)
         timer.setCompare(ccPeriodChannel, timer.captureCounter() + 10000000);
 
-    int eventsFired;
-
     sync();
 
-    // Now, walk the list and trigger any events that are pending.
-    do
+    // Trigger pending events, earliest first. The heap is re-examined after every event,
+    // as its handlers may have added or cancelled timer events.
+    while (eventCount > 0 && currentTimeUs >= timerEventList[0].timestamp)
     {
-        eventsFired = 0;
-        TimerEvent *e = timerEventList;
-
-        for (int i = 0; i<eventListSize; i++)
+        TimerEvent *e = &timerEventList[0];
+        uint16_t id = e->id;
+        uint16_t value = e->value;
+
+        // Release or reschedule before triggering event. Otherwise, an immediate event handler
+        // can cancel this event, another event might be put in its place
+        // and we end up releasing (or repeating) a completely different event.
+        if (e->period == 0)
+            removeTimerEvent(0);
+        else
         {
-            if (e->id != 0 && currentTimeUs >= e->timestamp)
-            {
-                uint16_t id = e->id;
-                uint16_t value = e->value;
-
-                // Release before triggering event. Otherwise, an immediate event handler
-                // can cancel this event, another event might be put in its place
-                // and we end up releasing (or repeating) a completely different event.
-                if (e->period == 0)
-                    releaseTimerEvent(e);
-                else
-                    e->timestamp += e->period;
-
-                // We need to trigger this event.
+            e->timestamp += e->period;
+            siftDown(0);
+        }
+
+        // We need to trigger this event.
 #if CONFIG_ENABLED(LIGHTWEIGHT_EVENTS)
-                Event evt(id, value, currentTime);
+        Event evt(id, value, currentTime);
 #else
-                Event evt(id, value, currentTimeUs);
+        Event evt(id, value, currentTimeUs);
 #endif
 
-                // TODO: Handle rollover case above...
-                eventsFired++;
-            }
-            e++;
-        }
-
-    } while (eventsFired);
+        // TODO: Handle rollover case above...
+    }
 
     // always recompute nextTimerEvent - event firing could have added new timer events
     recomputeNextTimerEvent();
@@ -526,8 +626,9 @@ int codal::system_timer_calibrate_cycles()
  * @param cycles the number of nops to execute
  * @return DEVICE_OK
  */
-void codal::system_timer_wait_cycles(uint32_t cycles)
+__attribute__((weak)) void codal::system_timer_wait_cycles(uint32_t cycles)
 {
+#if defined(__arm__)
     __asm__ __volatile__(
         ".syntax unified\n"
         "1:              \n"
@@ -537,6 +638,10 @@ void codal::system_timer_wait_cycles(uint32_t cycles)
         :                    // no input
         :                    // no clobber
     );
+#else
+    while (cycles--)
+        __asm__ __volatile__("");
+#endif
 }
 
 /**
@@ -395,7 +395,10 @@ GFATEntry *GhostFAT::addFile(GFATReadCallback read, void *userdata, const char *
     if (filesFinalized())
         target_panic(DEVICE_USB_ERROR);
 
-    GFATEntry *f = (GFATEntry *)malloc(sizeof(GFATEntry) + strlen(filename) + 1);
+    GFATEntry *f = (GFATEntry *)entries.allocate(sizeof(GFATEntry) + strlen(filename) + 1);
+    if (f == NULL)
+        target_panic(DEVICE_OOM);
+
     memset(f, 0, sizeof(GFATEntry));
     strcpy(f->filename, filename);
     f->size = size;
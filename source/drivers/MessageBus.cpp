@@ -51,12 +51,97 @@ DEALINGS IN THE SOFTWARE.
 #include "CodalFiber.h"
 #include "ErrorNo.h"
 #include "NotifyEvents.h"
+#include "Timer.h"
+#include "CodalDmesg.h"
 #include "codal_target_hal.h"
 
 using namespace codal;
 
 static uint16_t userNotifyId = DEVICE_NOTIFY_USER_EVENT_BASE;
 
+#if CONFIG_ENABLED(MESSAGE_BUS_TRACE)
+static MessageBusTraceRecord traceRing[MESSAGE_BUS_TRACE_SIZE];     // The most recent trace records.
+static uint16_t traceHead = 0;                                      // The index of the next record to write.
+static uint16_t traceLength = 0;                                    // The number of valid records.
+static MessageBusLatencyHistogram latencyHistograms[MESSAGE_BUS_TRACE_IDS];
+static uint16_t latencyHistogramCount = 0;                          // The number of entries of latencyHistograms in use.
+
+/**
+  * Adds a record to the trace ring, overwriting the oldest record if it is full.
+  *
+  * @param type The MESSAGE_BUS_TRACE type of the record.
+  *
+  * @param evt The event concerned.
+  *
+  * @param latency The latency of a delivered event, in microseconds.
+  */
+static void trace(uint8_t type, const Event &evt, uint32_t latency = 0)
+{
+    target_disable_irq();
+
+    MessageBusTraceRecord &r = traceRing[traceHead];
+
+    r.time = (uint32_t) system_timer_current_time_us();
+    r.id = evt.source;
+    r.value = evt.value;
+    r.info = ((uint32_t)type << 24) | (latency < 0xFFFFFF ? latency : 0xFFFFFF);
+
+    traceHead = (traceHead + 1) % MESSAGE_BUS_TRACE_SIZE;
+    if (traceLength < MESSAGE_BUS_TRACE_SIZE)
+        traceLength++;
+
+    target_enable_irq();
+}
+
+/**
+  * Records the delivery of the given event to a standard listener, in the trace ring and the latency histogram of its id.
+  *
+  * @param evt The event being delivered.
+  */
+static void trace_delivery(const Event &evt)
+{
+#if CONFIG_ENABLED(LIGHTWEIGHT_EVENTS)
+    uint32_t latency = (uint32_t)(system_timer_current_time() - evt.timestamp) * 1000;
+#else
+    uint32_t latency = (uint32_t)(system_timer_current_time_us() - evt.timestamp);
+#endif
+    MessageBusLatencyHistogram *h = NULL;
+    int bucket = 0;
+
+    trace(MESSAGE_BUS_TRACE_DELIVERED, evt, latency);
+
+    while (latency > 0 && bucket < MESSAGE_BUS_LATENCY_BUCKETS - 1)
+    {
+        latency >>= 1;
+        bucket++;
+    }
+
+    target_disable_irq();
+
+    for (int i = 0; i < latencyHistogramCount && h == NULL; i++)
+        if (latencyHistograms[i].id == evt.source)
+            h = &latencyHistograms[i];
+
+    // The last entry is shared by all ids once the others are taken.
+    if (h == NULL)
+    {
+        if (latencyHistogramCount < MESSAGE_BUS_TRACE_IDS)
+        {
+            h = &latencyHistograms[latencyHistogramCount++];
+            memset(h, 0, sizeof(MessageBusLatencyHistogram));
+            h->id = latencyHistogramCount == MESSAGE_BUS_TRACE_IDS ? DEVICE_ID_ANY : evt.source;
+        }
+        else
+            h = &latencyHistograms[MESSAGE_BUS_TRACE_IDS - 1];
+    }
+
+    if (h->buckets[bucket] < 0xFFFF)
+        h->buckets[bucket]++;
+
+    target_enable_irq();
+}
+#endif
+
 /**
   * Default constructor.
   *
@@ -66,9 +151,16 @@ static uint16_t userNotifyId = DEVICE_NOTIFY_USER_EVENT_BASE;
 MessageBus::MessageBus()
 {
     this->listeners = NULL;
-    this->evt_queue_head = NULL;
-    this->evt_queue_tail = NULL;
+    this->queueHead = 0;
     this->queueLength = 0;
+    this->queuePeak = 0;
+    this->droppedEvents = 0;
+    this->coalescedEvents = 0;
+    this->coalescedCount = 0;
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_INDEX)
+    this->listenerIndex = NULL;
+    this->listenerIndexSize = 0;
+#endif
 
     // ANY listeners for scheduler events MUST be immediate, or else they will not be registered.
     listen(DEVICE_ID_SCHEDULER, DEVICE_SCHEDULER_EVT_IDLE, this, &MessageBus::idle, MESSAGE_BUS_LISTENER_IMMEDIATE);
@@ -77,6 +169,127 @@ MessageBus::MessageBus()
         EventModel::defaultEventBus = this;
 }
 
+/**
+  * Allocates a batch able to hold the given number of events.
+  *
+  * @param count The number of events.
+  *
+  * @return The batch, or NULL if there is insufficient memory.
+  */
+static EventBatch *allocate_batch(int count)
+{
+    EventBatch *batch = (EventBatch *) malloc(sizeof(EventBatch) + (count - 1) * sizeof(Event));
+
+    if (batch != NULL)
+    {
+        batch->listener = NULL;
+        batch->count = 0;
+    }
+
+    return batch;
+}
+
+/**
+  * Calls the handler of the given listener, and records whether it blocked.
+  *
+  * @param listener The listener to call.
+  *
+  * @param batch The events to pass to a batch listener, or NULL to pass the current event of the listener.
+  */
+static void call_listener(Listener *listener, EventBatch *batch)
+{
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_STATISTICS) || CONFIG_ENABLED(MESSAGE_BUS_ADAPTIVE_DISPATCH)
+    // If the handler blocks in a fork on block context, we return here on a newly forked fiber.
+    Fiber *caller = currentFiber;
+#endif
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_STATISTICS)
+    CODAL_TIMESTAMP start = system_timer_current_time_us();
+#endif
+#if CONFIG_ENABLED(MESSAGE_BUS_TRACE)
+    // Urgent listeners run as each event is raised, so only standard listeners are traced. A batch is traced by its oldest event.
+    if ((listener->flags & MESSAGE_BUS_LISTENER_IMMEDIATE) != MESSAGE_BUS_LISTENER_IMMEDIATE)
+        trace_delivery(batch ? batch->events[0] : listener->evt);
+#endif
+
+    // Firstly, check for a method callback into an object.
+    if (listener->flags & MESSAGE_BUS_LISTENER_METHOD)
+        listener->cb_method->fire(listener->evt);
+
+    // Now a parameterised C function
+    else if (listener->flags & MESSAGE_BUS_LISTENER_PARAMETERISED)
+        listener->cb_param(listener->evt, listener->cb_arg);
+
+    // A batch of events, or a batch of one.
+    else if (listener->flags & MESSAGE_BUS_LISTENER_BATCH)
+    {
+        if (batch)
+            listener->cb_batch(batch->events, batch->count);
+        else
+        {
+            // The event of the listener may be overwritten if the handler blocks, so take a copy.
+            Event evt = listener->evt;
+            listener->cb_batch(&evt, 1);
+        }
+    }
+
+    // We must have a plain C function
+    else
+        listener->cb(listener->evt);
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_STATISTICS) || CONFIG_ENABLED(MESSAGE_BUS_ADAPTIVE_DISPATCH)
+    bool blocked = currentFiber != caller;
+
+    if (blocked)
+        listener->flags |= MESSAGE_BUS_LISTENER_HAS_BLOCKED;
+#endif
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_STATISTICS)
+    listener->invocations++;
+    listener->run_time += system_timer_current_time_us() - start;
+
+    if (blocked)
+        listener->blocks++;
+#endif
+}
+
+/**
+  * Calls the handler of the given listener, followed by that of any events queued on it whilst it was busy.
+  * The listener must already be marked as MESSAGE_BUS_LISTENER_BUSY.
+  *
+  * @param listener The listener to run.
+  *
+  * @param batch The batch of events to deliver first, or NULL to deliver the current event of the listener.
+  *              The batch is freed once delivered.
+  */
+static void run_listener(Listener *listener, EventBatch *batch = NULL)
+{
+    while (1)
+    {
+        call_listener(listener, batch);
+
+        // Any events that arrived whilst a batch was being handled were queued individually.
+        free(batch);
+        batch = NULL;
+
+        // If there are more events to process, dequeue the next one and process it.
+        if ((listener->flags & (MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY | MESSAGE_BUS_LISTENER_LATEST_ONLY)) && listener->evt_queue)
+        {
+            EventQueueItem *item = listener->evt_queue;
+
+            listener->evt = item->evt;
+            listener->evt_queue = listener->evt_queue->next;
+            delete item;
+
+            // We spin the scheduler here, to preven any particular event handler from continuously holding onto resources.
+            schedule();
+        }
+        else
+            break;
+    }
+
+    // The fiber of exiting... clear our state.
+    listener->flags &= ~MESSAGE_BUS_LISTENER_BUSY;
+}
+
 /**
   * Invokes a callback on a given Listener
   *
@@ -99,7 +312,7 @@ void async_callback(void *param)
             return;
 
         // Queue this event up for later, if that's how we've been configured.
-        if (listener->flags & MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY)
+        if (listener->flags & (MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY | MESSAGE_BUS_LISTENER_LATEST_ONLY))
         {
             listener->queue(listener->evt);
             return;
@@ -112,40 +325,56 @@ void async_callback(void *param)
     // Record that we have a fiber going into this listener...
     listener->flags |= MESSAGE_BUS_LISTENER_BUSY;
 
-    while (1)
-    {
-        // Firstly, check for a method callback into an object.
-        if (listener->flags & MESSAGE_BUS_LISTENER_METHOD)
-            listener->cb_method->fire(listener->evt);
+    run_listener(listener);
+}
 
-        // Now a parameterised C function
-        else if (listener->flags & MESSAGE_BUS_LISTENER_PARAMETERISED)
-            listener->cb_param(listener->evt, listener->cb_arg);
+/**
+  * Invokes a batch listener with a batch of events.
+  * The listener is marked as MESSAGE_BUS_LISTENER_BUSY before this is invoked.
+  *
+  * @param param The EventBatch to deliver, with its listener set.
+  */
+static void batch_callback(void *param)
+{
+    EventBatch *batch = (EventBatch *)param;
 
-        // We must have a plain C function
-        else
-            listener->cb(listener->evt);
+    run_listener(batch->listener, batch);
+}
 
+#if CONFIG_ENABLED(MESSAGE_BUS_ADAPTIVE_DISPATCH)
+/**
+  * Entry point of a fiber launched directly for a listener known to block.
+  * The listener is marked as MESSAGE_BUS_LISTENER_BUSY when the fiber is created, so that
+  * its event cannot be overwritten before the fiber is first scheduled.
+  */
+static void async_callback_fiber(void *param)
+{
+    run_listener((Listener *)param);
+}
 
-        // If there are more events to process, dequeue the next one and process it.
-        if ((listener->flags & MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY) && listener->evt_queue)
-        {
-            EventQueueItem *item = listener->evt_queue;
+/**
+  * Dispatches the current event of the given listener, based on how it has behaved in the past.
+  *
+  * @param l The listener to dispatch.
+  */
+static void adaptive_callback(Listener *l)
+{
+    // Listeners known to block go straight to a fiber, unless they're already busy, in which
+    // case async_callback() will queue or drop the event as configured.
+    if ((l->flags & (MESSAGE_BUS_LISTENER_HAS_BLOCKED | MESSAGE_BUS_LISTENER_BUSY)) == MESSAGE_BUS_LISTENER_HAS_BLOCKED)
+    {
+        l->flags |= MESSAGE_BUS_LISTENER_BUSY;
 
-            listener->evt = item->evt;
-            listener->evt_queue = listener->evt_queue->next;
-            delete item;
+        if (create_fiber(async_callback_fiber, l))
+            return;
 
-            // We spin the scheduler here, to preven any particular event handler from continuously holding onto resources.
-            schedule();
-        }
-        else
-            break;
+        l->flags &= ~MESSAGE_BUS_LISTENER_BUSY;
     }
 
-    // The fiber of exiting... clear our state.
-    listener->flags &= ~MESSAGE_BUS_LISTENER_BUSY;
+    // Anything else may yet block, so still needs a fork on block context.
+    invoke(async_callback, l);
 }
+#endif
 
 /**
   * Queue the given event for processing at a later time.
@@ -156,76 +385,301 @@ void async_callback(void *param)
 void MessageBus::queueEvent(Event &evt)
 {
     int processingComplete;
+    int slot = -1;
+
+    // If an identical event is already waiting and this type of event is coalesced, the waiting event stands in for this one.
+    // Only our urgent handlers need to see it.
+    target_disable_irq();
+    int coalesced = coalesceEvent(evt);
+    target_enable_irq();
+
+    if (coalesced)
+    {
+#if CONFIG_ENABLED(MESSAGE_BUS_TRACE)
+        trace(MESSAGE_BUS_TRACE_COALESCED, evt);
+#endif
+        this->process(evt, true);
+        return;
+    }
+
+    // We reserve an entry at the tail of the queue before processing any urgent handlers.
+    // This is important as that processing *may* generate further events, and
+    // we want to maintain ordering of events.
+    target_disable_irq();
+
+    if (queueLength < MESSAGE_BUS_EVENT_QUEUE_SIZE)
+    {
+        slot = (queueHead + queueLength) % MESSAGE_BUS_EVENT_QUEUE_SIZE;
+        eventQueueState[slot] = MESSAGE_BUS_QUEUE_SLOT_RESERVED;
+        queueLength++;
 
-    EventQueueItem *prev = evt_queue_tail;
+        if (queueLength > queuePeak)
+            queuePeak = queueLength;
+    }
+
+    target_enable_irq();
 
     // Now process all handler regsitered as URGENT.
     // These pre-empt the queue, and are useful for fast, high priority services.
     processingComplete = this->process(evt, true);
 
-    // If we've already processed all event handlers, we're all done.
-    // No need to queue the event.
-    if (processingComplete)
-        return;
+    target_disable_irq();
 
-    // If we need to queue, but there is no space, then there's nothg we can do.
-    if (queueLength >= MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH)
-        return;
+    if (slot < 0)
+    {
+        // If we need to queue, but there is no space, then there's nothg we can do.
+        if (!processingComplete)
+            droppedEvents++;
+    }
+    else if (processingComplete)
+    {
+        // If we've already processed all event handlers, we're all done.
+        // No need to queue the event.
+        eventQueueState[slot] = MESSAGE_BUS_QUEUE_SLOT_CANCELLED;
+        trimEventQueue();
+    }
+    else
+    {
+        // Otherwise, we need to queue this event for later processing...
+        eventQueue[slot] = evt;
+        eventQueueState[slot] = MESSAGE_BUS_QUEUE_SLOT_READY;
+    }
 
-    // Otherwise, we need to queue this event for later processing...
-    // We queue this event at the tail of the queue at the point where we entered queueEvent()
-    // This is important as the processing above *may* have generated further events, and
-    // we want to maintain ordering of events.
-    EventQueueItem *item = new EventQueueItem(evt);
+    target_enable_irq();
 
-    // The queue was empty when we entered this function, so queue our event at the start of the queue.
-    target_disable_irq();
+#if CONFIG_ENABLED(MESSAGE_BUS_TRACE)
+    if (!processingComplete)
+        trace(slot < 0 ? MESSAGE_BUS_TRACE_DROPPED : MESSAGE_BUS_TRACE_RAISED, evt);
+#endif
+}
 
-    if (prev == NULL)
+/**
+  * Releases any cancelled entries at either end of the event queue.
+  * Must be called with interrupts disabled.
+  */
+void MessageBus::trimEventQueue()
+{
+    while (queueLength > 0 && eventQueueState[queueHead] == MESSAGE_BUS_QUEUE_SLOT_CANCELLED)
     {
-        item->next = evt_queue_head;
-        evt_queue_head = item;
+        queueHead = (queueHead + 1) % MESSAGE_BUS_EVENT_QUEUE_SIZE;
+        queueLength--;
     }
-    else
+
+    while (queueLength > 0 && eventQueueState[(queueHead + queueLength - 1) % MESSAGE_BUS_EVENT_QUEUE_SIZE] == MESSAGE_BUS_QUEUE_SLOT_CANCELLED)
+        queueLength--;
+}
+
+/**
+  * Merges the given event with an identical event waiting on the event queue, if the event is configured to coalesce.
+  * Must be called with interrupts disabled.
+  *
+  * @param evt The event raised.
+  *
+  * @return 1 if the event was merged, and does not need to be queued, 0 otherwise.
+  */
+int MessageBus::coalesceEvent(Event &evt)
+{
+    int i;
+
+    for (i = 0; i < coalescedCount; i++)
     {
-        item->next = prev->next;
-        prev->next = item;
+        uint32_t key = coalesced[i];
+
+        if ((key >> 16) == evt.source && ((key & 0xffff) == DEVICE_EVT_ANY || (key & 0xffff) == evt.value))
+            break;
+    }
+
+    if (i == coalescedCount)
+        return 0;
+
+    for (i = 0; i < queueLength; i++)
+    {
+        int slot = (queueHead + i) % MESSAGE_BUS_EVENT_QUEUE_SIZE;
+
+        if (eventQueueState[slot] == MESSAGE_BUS_QUEUE_SLOT_READY && eventQueue[slot].source == evt.source && eventQueue[slot].value == evt.value)
+        {
+            eventQueue[slot].timestamp = evt.timestamp;
+            coalescedEvents++;
+            return 1;
+        }
     }
 
-    if (item->next == NULL)
-        evt_queue_tail = item;
+    return 0;
+}
+
+/**
+  * Configures whether events of the given type are coalesced whilst they wait to be processed.
+  *
+  * A coalesced event that is raised whilst an identical event (same id and value) is already waiting
+  * on the event queue is not queued again. Instead, the timestamp of the waiting event is updated,
+  * so that listeners see one event, carrying the time of the most recent. Listeners registered as
+  * MESSAGE_BUS_LISTENER_URGENT still receive every event.
+  *
+  * @param id The source of the events.
+  *
+  * @param value The value of the events, or DEVICE_EVT_ANY for all events from the given source.
+  *
+  * @param enable true to coalesce the events, false to queue each one.
+  *
+  * @return DEVICE_OK on success, or DEVICE_NO_RESOURCES if MESSAGE_BUS_COALESCE_MAX event types are already coalesced.
+  */
+int MessageBus::setCoalescing(uint16_t id, uint16_t value, bool enable)
+{
+    uint32_t key = ((uint32_t)id << 16) | value;
+    int i;
+    int result = DEVICE_OK;
+
+    target_disable_irq();
+
+    for (i = 0; i < coalescedCount; i++)
+        if (coalesced[i] == key)
+            break;
 
-    queueLength++;
+    if (enable && i == coalescedCount)
+    {
+        if (coalescedCount < MESSAGE_BUS_COALESCE_MAX)
+            coalesced[coalescedCount++] = key;
+        else
+            result = DEVICE_NO_RESOURCES;
+    }
+
+    if (!enable && i < coalescedCount)
+        coalesced[i] = coalesced[--coalescedCount];
 
     target_enable_irq();
+
+    return result;
 }
 
 /**
   * Extract the next event from the front of the event queue (if present).
   *
-  * @return a pointer to the EventQueueItem that is at the head of the list.
+  * @param evt Set to the event at the head of the queue.
+  *
+  * @return 1 if an event was extracted, 0 if there are no events ready to process.
   */
-EventQueueItem* MessageBus::dequeueEvent()
+int MessageBus::dequeueEvent(Event &evt)
 {
-    EventQueueItem *item = NULL;
+    int dequeued = 0;
 
     target_disable_irq();
 
-    if (evt_queue_head != NULL)
+    // An entry that is still reserved has yet to be written, so its event (and any after it) must wait.
+    // The same goes for the events of a batch, until sendBatch() has queued all of them.
+    if (queueLength > 0 && (eventQueueState[queueHead] == MESSAGE_BUS_QUEUE_SLOT_READY || (eventQueueState[queueHead] == MESSAGE_BUS_QUEUE_SLOT_BATCHED && batchLength() > 0)))
     {
-        item = evt_queue_head;
-        evt_queue_head = item->next;
+        evt = eventQueue[queueHead];
+        queueHead = (queueHead + 1) % MESSAGE_BUS_EVENT_QUEUE_SIZE;
+        queueLength--;
+
+        trimEventQueue();
+        dequeued = 1;
+    }
+
+    target_enable_irq();
+
+    return dequeued;
+}
+
+/**
+  * Extract the batch of events at the front of the event queue, if the event there was raised through sendBatch().
+  *
+  * @return The batch, to be freed by the caller, or NULL if the event at the front of the queue is not part of
+  *         a complete batch, or there is insufficient memory to hold it.
+  */
+EventBatch *MessageBus::dequeueBatch()
+{
+    target_disable_irq();
+    int count = batchLength();
+    target_enable_irq();
+
+    if (count <= 0)
+        return NULL;
+
+    // Only this function and dequeueEvent() remove events, so the batch remains at the front of the queue whilst we allocate.
+    EventBatch *batch = allocate_batch(count);
+
+    if (batch == NULL)
+        return NULL;
 
-        if (evt_queue_head == NULL)
-            evt_queue_tail = NULL;
+    target_disable_irq();
+
+    while (batch->count < count)
+    {
+        if (eventQueueState[queueHead] != MESSAGE_BUS_QUEUE_SLOT_CANCELLED)
+            batch->events[batch->count++] = eventQueue[queueHead];
 
+        queueHead = (queueHead + 1) % MESSAGE_BUS_EVENT_QUEUE_SIZE;
         queueLength--;
     }
 
+    trimEventQueue();
+
     target_enable_irq();
 
+    return batch;
+}
+
+/**
+  * Determines the number of events in the batch at the front of the event queue.
+  * Must be called with interrupts disabled.
+  *
+  * @return The number of events in the batch, 0 if the event at the front of the queue is not part of a batch,
+  *         or -1 if the batch is still being queued by sendBatch().
+  */
+int MessageBus::batchLength()
+{
+    int count = 0;
+
+    if (queueLength == 0 || eventQueueState[queueHead] != MESSAGE_BUS_QUEUE_SLOT_BATCHED)
+        return 0;
+
+    // The last event of a batch is marked as ready once all of those before it have been queued.
+    for (int i = 0; i < queueLength; i++)
+    {
+        uint8_t state = eventQueueState[(queueHead + i) % MESSAGE_BUS_EVENT_QUEUE_SIZE];
+
+        if (state == MESSAGE_BUS_QUEUE_SLOT_BATCHED)
+            count++;
+
+        if (state == MESSAGE_BUS_QUEUE_SLOT_READY)
+            return count + 1;
+
+        if (state == MESSAGE_BUS_QUEUE_SLOT_RESERVED)
+            break;
+    }
 
-    return item;
+    return -1;
+}
+
+/**
+  * Determines the number of events dropped as the event queue was full.
+  *
+  * @return The number of events dropped since the MessageBus was created.
+  */
+uint32_t MessageBus::getDroppedEventCount()
+{
+    return droppedEvents;
+}
+
+/**
+  * Determines the number of events merged into an identical waiting event, rather than being queued (see setCoalescing()).
+  *
+  * @return The number of events coalesced since the MessageBus was created.
+  */
+uint32_t MessageBus::getCoalescedEventCount()
+{
+    return coalescedEvents;
+}
+
+/**
+  * Determines the largest number of events that have been held in the event queue at once.
+  *
+  * @return The peak length of the event queue, up to MESSAGE_BUS_EVENT_QUEUE_SIZE.
+  */
+int MessageBus::getPeakQueueLength()
+{
+    return queuePeak;
 }
 
 /**
@@ -236,6 +690,7 @@ EventQueueItem* MessageBus::dequeueEvent()
 int MessageBus::deleteMarkedListeners()
 {
     Listener *l, *p;
+    Listener *removedListeners = NULL;
     int removed = 0;
 
     l = listeners;
@@ -251,11 +706,12 @@ int MessageBus::deleteMarkedListeners()
             else
                 p->next = l->next;
 
-            // delete the listener.
+            // Hold onto the listener until no index can refer to it.
             Listener *t = l;
             l = l->next;
 
-            delete t;
+            t->next = removedListeners;
+            removedListeners = t;
             removed++;
 
             continue;
@@ -265,6 +721,20 @@ int MessageBus::deleteMarkedListeners()
         l = l->next;
     }
 
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_INDEX)
+    if (removed > 0)
+        rebuildListenerIndex();
+#endif
+
+    // delete the listeners.
+    while (removedListeners != NULL)
+    {
+        Listener *t = removedListeners;
+        removedListeners = t->next;
+
+        delete t;
+    }
+
     return removed;
 }
 
@@ -279,25 +749,33 @@ void MessageBus::idle(Event)
     // Clear out any listeners marked for deletion
     this->deleteMarkedListeners();
 
-    EventQueueItem *item = this->dequeueEvent();
+    Event evt(DEVICE_ID_ANY, DEVICE_EVT_ANY, (CODAL_TIMESTAMP) 0, CREATE_ONLY);
 
     // Whilst there are events to process and we have no useful other work to do, pull them off the queue and process them.
-    while (item)
+    while (1)
     {
-        // send the event to all standard event listeners.
-        this->process(item->evt);
+        // Events raised through sendBatch() are taken from the queue together, in their place among other events.
+        EventBatch *batch = this->dequeueBatch();
+
+        if (batch)
+        {
+            this->processBatch(batch);
+            free(batch);
+        }
 
-        // Free the queue item.
-        delete item;
+        // Otherwise, send the event to all standard event listeners.
+        // Should there be too little memory to take a batch at once, this takes its events one at a time.
+        else if (this->dequeueEvent(evt))
+            this->process(evt);
+
+        else
+            break;
 
         // If we have created some useful work to do, we stop processing.
         // This helps to minimise the number of blocked fibers we create at any point in time, therefore
         // also reducing the RAM footprint.
         if(!scheduler_runqueue_empty())
-            break;
-
-        // Pull the next event to process, if there is one.
-        item = this->dequeueEvent();
+            return;
     }
 }
 
@@ -330,6 +808,188 @@ int MessageBus::send(Event evt)
     return DEVICE_OK;
 }
 
+/**
+  * Queues the given events to be sent to all registered recipients, as a batch.
+  *
+  * Urgent listeners receive each event immediately, as with send(). The events are then held on the
+  * event queue, in order with those raised through send(), and processed in a single pass over the
+  * listeners once they reach the front of the queue. Listeners registered with a batch handler receive
+  * all of their matching events in one call, and other listeners receive each matching event in turn.
+  * This function allocates no memory, so may be called from interrupt context.
+  *
+  * @param events The events to send. These are copied, so need not remain valid after this call.
+  *
+  * @param count The number of events to send.
+  *
+  * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if events is NULL or count is not positive,
+  *         or DEVICE_NO_RESOURCES if the event queue cannot hold the whole batch, in which case any events
+  *         not taken by urgent listeners are dropped.
+  */
+int MessageBus::sendBatch(const Event *events, int count)
+{
+    int first = -1;
+    int pending = -1;
+    int result = DEVICE_OK;
+
+    if (events == NULL || count <= 0)
+        return DEVICE_INVALID_PARAMETER;
+
+    // As in queueEvent(), we reserve entries at the tail of the queue for the whole batch before processing
+    // any urgent handlers, so that the batch keeps its place among any events they raise.
+    target_disable_irq();
+
+    if (queueLength + count <= MESSAGE_BUS_EVENT_QUEUE_SIZE)
+    {
+        first = (queueHead + queueLength) % MESSAGE_BUS_EVENT_QUEUE_SIZE;
+
+        for (int i = 0; i < count; i++)
+            eventQueueState[(first + i) % MESSAGE_BUS_EVENT_QUEUE_SIZE] = MESSAGE_BUS_QUEUE_SLOT_RESERVED;
+
+        queueLength += count;
+
+        if (queueLength > queuePeak)
+            queuePeak = queueLength;
+    }
+
+    target_enable_irq();
+
+    // Process all handlers registered as URGENT, and keep those events that need further processing.
+    for (int i = 0; i < count; i++)
+    {
+        Event evt = events[i];
+        int processingComplete = this->process(evt, true);
+
+        if (first < 0)
+        {
+            // If we need to queue, but there is no space, then there's nothing we can do.
+            if (!processingComplete)
+            {
+                droppedEvents++;
+                result = DEVICE_NO_RESOURCES;
+#if CONFIG_ENABLED(MESSAGE_BUS_TRACE)
+                trace(MESSAGE_BUS_TRACE_DROPPED, evt);
+#endif
+            }
+
+            continue;
+        }
+
+        int slot = (first + i) % MESSAGE_BUS_EVENT_QUEUE_SIZE;
+
+        target_disable_irq();
+
+        if (processingComplete)
+        {
+            eventQueueState[slot] = MESSAGE_BUS_QUEUE_SLOT_CANCELLED;
+            trimEventQueue();
+        }
+        else
+        {
+            // The last event kept stays reserved until we know whether it ends the batch,
+            // so that the batch cannot be taken from the queue before it is complete.
+            eventQueue[slot] = evt;
+
+            if (pending >= 0)
+                eventQueueState[pending] = MESSAGE_BUS_QUEUE_SLOT_BATCHED;
+
+            pending = slot;
+        }
+
+        target_enable_irq();
+
+#if CONFIG_ENABLED(MESSAGE_BUS_TRACE)
+        if (!processingComplete)
+            trace(MESSAGE_BUS_TRACE_RAISED, evt);
+#endif
+    }
+
+    if (pending >= 0)
+    {
+        target_disable_irq();
+        eventQueueState[pending] = MESSAGE_BUS_QUEUE_SLOT_READY;
+        target_enable_irq();
+    }
+
+    return result;
+}
+
+/**
+  * Delivers the given batch of events to all relevant standard listeners, in a single pass over the listeners.
+  *
+  * @param batch The batch to deliver.
+  */
+void MessageBus::processBatch(EventBatch *batch)
+{
+    for (Listener *l = listeners; l != NULL; l = l->next)
+    {
+        // Urgent listeners received each event as it was raised.
+        if ((l->flags & MESSAGE_BUS_LISTENER_DELETING) || (l->flags & MESSAGE_BUS_LISTENER_IMMEDIATE) == MESSAGE_BUS_LISTENER_IMMEDIATE)
+            continue;
+
+        if (!(l->flags & MESSAGE_BUS_LISTENER_BATCH))
+        {
+            for (int i = 0; i < batch->count; i++)
+            {
+                Event &evt = batch->events[i];
+
+                if ((l->id == evt.source || l->id == DEVICE_ID_ANY) && (l->value == evt.value || l->value == DEVICE_EVT_ANY))
+                    deliver(l, evt, false);
+            }
+
+            continue;
+        }
+
+        // Gather the events of interest to this batch listener.
+        EventBatch *matched = NULL;
+
+        for (int i = 0; i < batch->count; i++)
+        {
+            Event &evt = batch->events[i];
+
+            if (!((l->id == evt.source || l->id == DEVICE_ID_ANY) && (l->value == evt.value || l->value == DEVICE_EVT_ANY)))
+                continue;
+
+            // A busy listener takes the events one at a time once it is done, if that's how it has been configured.
+            if (l->flags & MESSAGE_BUS_LISTENER_BUSY)
+            {
+                if (l->flags & MESSAGE_BUS_LISTENER_DROP_IF_BUSY)
+                    break;
+
+                if (l->flags & (MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY | MESSAGE_BUS_LISTENER_LATEST_ONLY))
+                {
+                    l->queue(evt);
+                    continue;
+                }
+            }
+
+            if (matched == NULL)
+            {
+                matched = allocate_batch(batch->count - i);
+
+                if (matched == NULL)
+                {
+                    droppedEvents++;
+                    continue;
+                }
+
+                matched->listener = l;
+            }
+
+            matched->events[matched->count++] = evt;
+        }
+
+        if (matched)
+        {
+            l->flags |= MESSAGE_BUS_LISTENER_BUSY;
+
+            if (fiber_scheduler_running())
+                invoke(batch_callback, matched);
+            else
+                batch_callback(matched);
+        }
+    }
+}
+
 /**
   * Internal function, used to deliver the given event to all relevant recipients.
   * Normally, this is called once an event has been removed from the event queue.
@@ -348,39 +1008,42 @@ int MessageBus::process(Event &evt, bool urgent)
 {
     Listener *l;
     int complete = 1;
-    bool listenerUrgent;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_INDEX)
+    Listener *first = NULL;
+    bool indexed;
+
+    target_disable_irq();
+
+    indexed = listenerIndex != NULL;
+    if (indexed)
+        first = findListeners(evt.source);
+
+    target_enable_irq();
+
+    if (indexed)
+    {
+        // Listeners for DEVICE_ID_ANY are held at the head of the list, as the list is sorted by id.
+        for (l = listeners; l != NULL && l->id == DEVICE_ID_ANY; l = l->next)
+            if (l->value == evt.value || l->value == DEVICE_EVT_ANY)
+                complete &= deliver(l, evt, urgent);
+
+        // The listeners for this event's id then follow one another on the list.
+        if (evt.source != DEVICE_ID_ANY)
+            for (l = first; l != NULL && l->id == evt.source; l = l->next)
+                if (l->value == evt.value || l->value == DEVICE_EVT_ANY)
+                    complete &= deliver(l, evt, urgent);
+
+        return complete;
+    }
+#endif
 
     l = listeners;
 
     while (l != NULL)
     {
         if((l->id == evt.source || l->id == DEVICE_ID_ANY) && (l->value == evt.value || l->value == DEVICE_EVT_ANY))
-        {
-            // If we're running under the fiber scheduler, then derive the THREADING_MODE for the callback based on the
-            // metadata in the listener itself.
-            if (fiber_scheduler_running())
-                listenerUrgent = (l->flags & MESSAGE_BUS_LISTENER_IMMEDIATE) == MESSAGE_BUS_LISTENER_IMMEDIATE;
-            else
-                listenerUrgent = true;
-
-            // If we should process this event hander in this pass, then activate the listener.
-            if(listenerUrgent == urgent && !(l->flags & MESSAGE_BUS_LISTENER_DELETING))
-            {
-                l->evt = evt;
-
-                // OK, if this handler has regisitered itself as non-blocking, we just execute it directly...
-                // This is normally only done for trusted system components.
-                // Otherwise, we invoke it in a 'fork on block' context, that will automatically create a fiber
-                // should the event handler attempt a blocking operation, but doesn't have the overhead
-                // of creating a fiber needlessly. (cool huh?)
-                if (l->flags & MESSAGE_BUS_LISTENER_NONBLOCKING || !fiber_scheduler_running())
-                    async_callback(l);
-                else
-                    invoke(async_callback, l);
-            }
-            else
-                complete = 0;
-        }
+            complete &= deliver(l, evt, urgent);
 
         l = l->next;
     }
@@ -391,6 +1054,125 @@ int MessageBus::process(Event &evt, bool urgent)
     return complete;
 }
 
+/**
+  * Delivers the given event to the given listener, if it is of the type being processed.
+  *
+  * @param l The listener, which must match the event.
+  *
+  * @param evt The event to deliver.
+  *
+  * @param urgent true if urgent listeners are being processed, false for standard listeners.
+  *
+  * @return 1 if the listener was processed, 0 if it requires further processing.
+  */
+int MessageBus::deliver(Listener *l, Event &evt, bool urgent)
+{
+    bool listenerUrgent;
+
+    // If we're running under the fiber scheduler, then derive the THREADING_MODE for the callback based on the
+    // metadata in the listener itself.
+    if (fiber_scheduler_running())
+        listenerUrgent = (l->flags & MESSAGE_BUS_LISTENER_IMMEDIATE) == MESSAGE_BUS_LISTENER_IMMEDIATE;
+    else
+        listenerUrgent = true;
+
+    // If we should process this event hander in this pass, then activate the listener.
+    if(listenerUrgent != urgent || (l->flags & MESSAGE_BUS_LISTENER_DELETING))
+        return 0;
+
+    l->evt = evt;
+
+    // OK, if this handler has regisitered itself as non-blocking, we just execute it directly...
+    // This is normally only done for trusted system components.
+    // Otherwise, we invoke it in a 'fork on block' context, that will automatically create a fiber
+    // should the event handler attempt a blocking operation, but doesn't have the overhead
+    // of creating a fiber needlessly. (cool huh?)
+    if (l->flags & MESSAGE_BUS_LISTENER_NONBLOCKING || !fiber_scheduler_running())
+        async_callback(l);
+    else
+#if CONFIG_ENABLED(MESSAGE_BUS_ADAPTIVE_DISPATCH)
+        adaptive_callback(l);
+#else
+        invoke(async_callback, l);
+#endif
+
+    return 1;
+}
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_INDEX)
+/**
+  * Rebuilds the listener index from the list of listeners.
+  * If there is insufficient memory, the index is discarded and all listeners are visited for each event.
+  */
+void MessageBus::rebuildListenerIndex()
+{
+    ListenerIndexEntry *index = NULL;
+    ListenerIndexEntry *old;
+    int count = 0;
+
+    // Count the distinct ids. Listeners for DEVICE_ID_ANY are always visited, so need no entry.
+    for (Listener *l = listeners, *p = NULL; l != NULL; p = l, l = l->next)
+        if (l->id != DEVICE_ID_ANY && (p == NULL || p->id != l->id))
+            count++;
+
+    if (count > 0)
+        index = (ListenerIndexEntry *) malloc(sizeof(ListenerIndexEntry) * count);
+
+    if (index != NULL)
+    {
+        int i = 0;
+
+        for (Listener *l = listeners; l != NULL; l = l->next)
+        {
+            if (l->id != DEVICE_ID_ANY && (i == 0 || index[i-1].id != l->id))
+            {
+                index[i].id = l->id;
+                index[i].first = l;
+                i++;
+            }
+        }
+    }
+
+    target_disable_irq();
+
+    old = listenerIndex;
+    listenerIndex = index;
+    listenerIndexSize = index ? count : 0;
+
+    target_enable_irq();
+
+    free(old);
+}
+
+/**
+  * Finds the first listener with the given id, using the listener index.
+  *
+  * @param id The event id.
+  *
+  * @return The first listener on the list with the given id, or NULL if there is none.
+  */
+Listener *MessageBus::findListeners(uint16_t id)
+{
+    int low = 0;
+    int high = listenerIndexSize - 1;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+
+        if (listenerIndex[mid].id == id)
+            return listenerIndex[mid].first;
+
+        if (listenerIndex[mid].id < id)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return NULL;
+}
+#endif
+
 /**
   * Add the given Listener to the list of event handlers, unconditionally.
   *
@@ -437,6 +1219,9 @@ int MessageBus::add(Listener *newListener)
     if (listeners == NULL)
     {
         listeners = newListener;
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_INDEX)
+        rebuildListenerIndex();
+#endif
         Event(DEVICE_ID_MESSAGE_BUS_LISTENER, newListener->id);
 
         return DEVICE_OK;
@@ -478,6 +1263,10 @@ int MessageBus::add(Listener *newListener)
         p->next = newListener;
     }
 
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_INDEX)
+    rebuildListenerIndex();
+#endif
+
     Event(DEVICE_ID_MESSAGE_BUS_LISTENER, newListener->id);
     return DEVICE_OK;
 }
@@ -553,6 +1342,53 @@ Listener* MessageBus::elementAt(int n)
     return l;
 }
 
+#if CONFIG_ENABLED(MESSAGE_BUS_TRACE)
+/**
+  * Writes the event trace to DMESG, and then clears it.
+  *
+  * The queue counters are written first, followed by one line per event id giving its latency histogram, as the
+  * id then the count in each bucket. The trace ring follows, oldest record first, as three hexadecimal words per
+  * record: the time, the id and value (id in the upper 16 bits), and the info field of MessageBusTraceRecord.
+  */
+void MessageBus::traceDump()
+{
+    DMESG("TRACE queue peak %d, dropped %d, coalesced %d", queuePeak, droppedEvents, coalescedEvents);
+
+    for (int i = 0; i < latencyHistogramCount; i++)
+    {
+        uint16_t *b = latencyHistograms[i].buckets;
+
+        DMESG("LATENCY %d: %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d", latencyHistograms[i].id,
+            b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], b[8], b[9], b[10], b[11], b[12], b[13], b[14], b[15]);
+    }
+
+    for (int i = 0; i < traceLength; i++)
+    {
+        MessageBusTraceRecord &r = traceRing[(traceHead + MESSAGE_BUS_TRACE_SIZE - traceLength + i) % MESSAGE_BUS_TRACE_SIZE];
+        DMESG("%x %x %x", r.time, ((uint32_t)r.id << 16) | r.value, r.info);
+    }
+
+    target_disable_irq();
+    traceLength = 0;
+    latencyHistogramCount = 0;
+    target_enable_irq();
+}
+#endif
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_STATISTICS)
+/**
+  * Writes the dispatch statistics of all listeners to DMESG.
+  *
+  * One line is written per listener, giving the number of times it has been invoked, the number of
+  * those invocations that blocked, and the average time spent in the handler in microseconds.
+  */
+void MessageBus::listenerStatisticsDump()
+{
+    for (Listener *l = listeners; l; l = l->next)
+        DMESG("LISTENER %d %d: invoked %d, blocked %d, avg %d us", l->id, l->value, l->invocations, l->blocks, l->invocations ? (uint32_t)(l->run_time / l->invocations) : 0);
+}
+#endif
+
 namespace codal {
 
 /**
@@ -571,4 +1407,8 @@ uint16_t allocateNotifyEvent()
 MessageBus::~MessageBus()
 {
     ignore(DEVICE_ID_SCHEDULER, DEVICE_EVT_ANY, this, &MessageBus::idle);
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_INDEX)
+    free(listenerIndex);
+#endif
 }
@@ -69,6 +69,10 @@ ST7735::ST7735(ScreenIO &io, Pin &cs, Pin &dc) : io(io), cs(&cs), dc(&dc), work(
 {
     double16 = false;
     inSleepMode = false;
+
+    // Only one transfer is ever in progress, so a single reserved slot guarantees that sendDone() is never lost.
+    if (fiber_defer_reserve() != DEVICE_OK)
+        target_panic(DEVICE_HARDWARE_CONFIGURATION_ERROR);
 }
 
 #define DELAY 0x80
@@ -259,7 +263,7 @@ void ST7735::sendColorsStep(ST7735 *st)
     }
 
     // with the current image format in PXT the sendBytes cases never happen
-    unsigned align = (unsigned)work->srcPtr & 3;
+    unsigned align = (uintptr_t)work->srcPtr & 3;
     if (work->srcLeft && align)
     {
         st->sendBytes(4 - align);
@@ -269,7 +273,10 @@ void ST7735::sendColorsStep(ST7735 *st)
         if (work->srcLeft == 0)
         {
             st->endCS();
-            Event(DEVICE_ID_DISPLAY, 100);
+
+            // sendDone() must run outside of interrupt context (see below). This uses the slot we reserved,
+            // so cannot fail, even if the deferred call queue is otherwise full.
+            fiber_defer(&ST7735::sendDone, st, true);
         }
         else
         {
@@ -301,11 +308,13 @@ void ST7735::startRAMWR(int cmd)
     beginCS();
 }
 
-void ST7735::sendDone(Event)
+void ST7735::sendDone(void *p)
 {
+    ST7735 *st = (ST7735 *)p;
+
     // this executes outside of interrupt context, so we don't get a race
     // with waitForSendDone
-    work->inProgress = false;
+    st->work->inProgress = false;
     Event(DEVICE_ID_DISPLAY, 101);
 }
 
@@ -355,7 +364,6 @@ int ST7735::sendIndexedImage(const uint8_t *src, unsigned width, unsigned height
         else
             for (int i = 0; i < 256; ++i)
                 work->expPalette[i] = 0x1011 * (i & 0xf) | (0x110100 * (i >> 4));
-        EventModel::defaultEventBus->listen(DEVICE_ID_DISPLAY, 100, this, &ST7735::sendDone);
     }
 
     if (work->inProgress || inSleepMode)
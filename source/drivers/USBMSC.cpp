@@ -63,11 +63,8 @@ DEALINGS IN THE SOFTWARE.
 
 #define STRICT 0
 
-#define DEVICE_MSC_EVT_START_READ 1
-#define DEVICE_MSC_EVT_START_WRITE 2
-
 #include "USBMassStorageClass.h"
-#include "EventModel.h"
+#include "CodalFiber.h"
 
 #define CPU_TO_LE32(x) (x)
 #define le32_to_cpu(x) (x)
@@ -192,8 +189,12 @@ USBMSC::USBMSC() : CodalUSBInterface()
     state->SenseData.ResponseCode = 0x70;
     state->SenseData.AdditionalLength = 0x0A;
     failed = false;
-    listen = false;
     disableIRQ = false;
+
+    // The endpoint is disabled until each read or write is done, so a single reserved slot guarantees that
+    // the deferred transfer is never lost.
+    if (fiber_defer_reserve() != DEVICE_OK)
+        target_panic(DEVICE_HARDWARE_CONFIGURATION_ERROR);
 }
 
 int USBMSC::sendResponse(bool ok)
@@ -459,29 +460,23 @@ void USBMSC::cmdReadWrite_10(bool isRead)
 
     failed = false;
 
-    if (!listen)
-    {
-        listen = true;
-        EventModel::defaultEventBus->listen(DEVICE_ID_MSC, DEVICE_MSC_EVT_START_READ, this,
-                                            &USBMSC::readHandler);
-        EventModel::defaultEventBus->listen(DEVICE_ID_MSC, DEVICE_MSC_EVT_START_WRITE, this,
-                                            &USBMSC::writeHandler);
-    }
-
     out->disableIRQ();
     disableIRQ = true;
-    // fire up event, to make sure transfers happen outside of IRQ context
-    Event e(DEVICE_ID_MSC, isRead ? DEVICE_MSC_EVT_START_READ : DEVICE_MSC_EVT_START_WRITE);
+    // defer the transfer, to make sure it happens outside of IRQ context
+    // this uses the slot we reserved, so cannot fail, even if the deferred call queue is otherwise full
+    fiber_defer(isRead ? &USBMSC::readHandler : &USBMSC::writeHandler, this, true);
 }
 
-void USBMSC::readHandler(Event)
+void USBMSC::readHandler(void *msc)
 {
-    readBlocks(blockAddr, blockCount);
+    USBMSC *m = (USBMSC *)msc;
+    m->readBlocks(m->blockAddr, m->blockCount);
 }
 
-void USBMSC::writeHandler(Event)
+void USBMSC::writeHandler(void *msc)
 {
-    writeBlocks(blockAddr, blockCount);
+    USBMSC *m = (USBMSC *)msc;
+    m->writeBlocks(m->blockAddr, m->blockCount);
 }
 
 bool USBMSC::cmdModeSense(bool is10)
@@ -138,3 +138,23 @@ EventQueueItem::EventQueueItem(Event evt)
     this->evt = evt;
     this->next = NULL;
 }
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_POOL)
+MemoryPool EventQueueItem::pool(sizeof(EventQueueItem), MESSAGE_BUS_EVENT_POOL_SIZE);
+
+/**
+  * Allocates memory for a new instance from the pool.
+  */
+void *EventQueueItem::operator new(size_t size)
+{
+    return pool.allocate(size);
+}
+
+/**
+  * Returns the memory of an instance to the pool.
+  */
+void EventQueueItem::operator delete(void *p)
+{
+    pool.release(p);
+}
+#endif
@@ -293,7 +293,7 @@ void Image::init(const int16_t x, const int16_t y, const uint8_t *bitmap)
 
 
     // Create a copy of the array
-    ptr = (ImageData*)malloc(sizeof(ImageData) + x * y);
+    ptr = (ImageData*)RefCounted::allocate(sizeof(ImageData) + x * y);
     REF_COUNTED_INIT(ptr);
     ptr->width = x;
     ptr->height = y;
@@ -138,7 +138,7 @@ void ManagedBuffer::init(uint8_t *data, int length, BufferInitialize initialize)
         return;
     }
 
-    ptr = (BufferData *) malloc(sizeof(BufferData) + length);
+    ptr = (BufferData *) RefCounted::allocate(sizeof(BufferData) + length);
     REF_COUNTED_INIT(ptr);
 
     ptr->length = length;
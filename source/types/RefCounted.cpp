@@ -24,14 +24,24 @@ DEALINGS IN THE SOFTWARE.
 
 /**
   * Base class for payload for ref-counted objects. Used by ManagedString and DeviceImage.
-  * There is no constructor, as this struct is typically malloc()ed.
+  * There is no constructor, as this struct is typically allocated with RefCounted::allocate().
   */
 #include "CodalConfig.h"
 #include "CodalDevice.h"
 #include "RefCounted.h"
+#include "CodalPool.h"
 
 using namespace codal;
 
+#if CONFIG_ENABLED(REF_COUNTED_POOL)
+// The space allowed in each pool block for the header of the payload types (e.g. the length field of BufferData),
+// so that a ManagedBuffer of exactly REF_COUNTED_POOL_MIN_SIZE << n bytes fits in class n.
+#define REF_COUNTED_POOL_HEADER_SIZE    8
+
+// The pool of each size class, created the first time a payload of that class is allocated.
+static MemoryPool *pools[REF_COUNTED_POOL_CLASSES];
+#endif
+
 /**
   * Checks if the object resides in flash memory.
   *
@@ -86,3 +96,70 @@ void RefCounted::decr()
         destroy();
     }
 }
+
+/**
+  * Allocates the memory for a payload. If REF_COUNTED_POOL is enabled, the payload is taken
+  * from the pool of its size class where possible, otherwise it is allocated from the heap.
+  *
+  * @param size The size of the payload in bytes, including this header.
+  *
+  * @return A pointer to the memory allocated, or NULL if there is insufficient memory.
+  */
+void *RefCounted::allocate(size_t size)
+{
+#if CONFIG_ENABLED(REF_COUNTED_POOL)
+    for (int i = 0; i < REF_COUNTED_POOL_CLASSES; i++)
+    {
+        size_t blockSize = (REF_COUNTED_POOL_MIN_SIZE << i) + REF_COUNTED_POOL_HEADER_SIZE;
+
+        if (size > blockSize)
+            continue;
+
+        if (pools[i] == NULL)
+        {
+            MemoryPool *pool = new MemoryPool(blockSize, REF_COUNTED_POOL_SIZE);
+
+            // Another allocation may have created the pool whilst we were doing so.
+            target_disable_irq();
+
+            if (pools[i] == NULL)
+            {
+                pools[i] = pool;
+                pool = NULL;
+            }
+
+            target_enable_irq();
+
+            delete pool;
+        }
+
+        if (pools[i] != NULL)
+            return pools[i]->allocate(size);
+
+        break;
+    }
+#endif
+
+    return malloc(size);
+}
+
+/**
+  * Releases the memory of a payload previously returned by allocate().
+  *
+  * @param p The payload to release.
+  */
+void RefCounted::deallocate(void *p)
+{
+#if CONFIG_ENABLED(REF_COUNTED_POOL)
+    for (int i = 0; i < REF_COUNTED_POOL_CLASSES; i++)
+    {
+        if (pools[i] != NULL && pools[i]->contains(p))
+        {
+            pools[i]->release(p);
+            return;
+        }
+    }
+#endif
+
+    free(p);
+}
@@ -34,7 +34,7 @@ using namespace codal;
   */
 void RefCounted::destroy()
 {
-    free(this);
+    deallocate(this);
 }
 
 /**